@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "configwriter.h"
+#include <chrono>
+#include <fcitx-config/iniparser.h>
+#include <fcitx-config/rawconfig.h>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace fcitx {
+
+namespace {
+
+// Changes that come in quick succession, e.g. while cycling the keyboard map
+// with a hotkey, are merged into one write.
+constexpr auto COALESCE_DELAY = std::chrono::milliseconds(200);
+
+} // namespace
+
+ThaiConfigWriter::ThaiConfigWriter(const std::string &path)
+    : ThaiConfigWriter(
+          [path](const RawConfig &config) { safeSaveAsIni(config, path); }) {}
+
+ThaiConfigWriter::ThaiConfigWriter(WriteCallback write)
+    : write_(std::move(write)) {}
+
+ThaiConfigWriter::~ThaiConfigWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wakeup_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ThaiConfigWriter::save(RawConfig config) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = std::move(config);
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&ThaiConfigWriter::run, this);
+        }
+    }
+    wakeup_.notify_one();
+}
+
+void ThaiConfigWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!pending_ && !writing_) {
+        return;
+    }
+    // Skip the coalescing delay.
+    flushWaiters_++;
+    wakeup_.notify_one();
+    written_.wait(lock, [this]() { return !pending_ && !writing_; });
+    flushWaiters_--;
+}
+
+void ThaiConfigWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wakeup_.wait(lock, [this]() { return stop_ || pending_; });
+        if (!pending_) {
+            break;
+        }
+        wakeup_.wait_for(lock, COALESCE_DELAY,
+                         [this]() { return stop_ || flushWaiters_ > 0; });
+        // Later saves replaced the snapshot meanwhile, take the latest.
+        RawConfig config = std::move(*pending_);
+        pending_.reset();
+        writing_ = true;
+        lock.unlock();
+        write_(config);
+        lock.lock();
+        writing_ = false;
+        written_.notify_all();
+    }
+}
+
+} // namespace fcitx
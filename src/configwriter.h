@@ -0,0 +1,59 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_CONFIGWRITER_H_
+#define _FCITX5_LIBTHAI_CONFIGWRITER_H_
+
+#include <condition_variable>
+#include <fcitx-config/rawconfig.h>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace fcitx {
+
+// Writes config snapshots to a file under the user config directory on a
+// background thread, so that a slow file system never blocks key handling.
+// Snapshots queued while a write is pending replace each other, only the
+// latest one reaches the disk.
+class ThaiConfigWriter {
+public:
+    using WriteCallback = std::function<void(const RawConfig &)>;
+
+    // Saves to path relative to the user config directory of fcitx.
+    explicit ThaiConfigWriter(const std::string &path);
+    // Runs write on the background thread instead, e.g. in tests.
+    explicit ThaiConfigWriter(WriteCallback write);
+    // Writes the pending snapshot before returning.
+    ~ThaiConfigWriter();
+
+    ThaiConfigWriter(const ThaiConfigWriter &) = delete;
+    ThaiConfigWriter &operator=(const ThaiConfigWriter &) = delete;
+
+    // The thread is started on the first call.
+    void save(RawConfig config);
+    // Wait until the pending snapshot, if any, is written.
+    void flush();
+
+private:
+    void run();
+
+    const WriteCallback write_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable written_;
+    std::optional<RawConfig> pending_;
+    bool writing_ = false;
+    int flushWaiters_ = 0;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_CONFIGWRITER_H_
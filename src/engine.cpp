@@ -5,27 +5,52 @@
  *
  */
 #include "engine.h"
+#include "clipboard_public.h"
+#include "libthai_public.h"
+#include "thaicodec.h"
+#include "thaicontext.h"
+#include "thaicore.h"
 #include "thaikb.h"
+#include "thaikblayout.h"
+#include "thainormalizer.h"
+#include "thaistats.h"
+#include "thaitrace.h"
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
-#include <deque>
+#include <ctime>
 #include <fcitx-utils/capabilityflags.h>
+#include <fcitx-utils/event.h>
+#include <fcitx-utils/i18n.h>
 #include <fcitx-utils/key.h>
 #include <fcitx-utils/keysym.h>
 #include <fcitx-utils/log.h>
+#include <fcitx-utils/standardpaths.h>
+#include <fcitx-utils/stringutils.h>
+#include <fcitx-utils/textformatflags.h>
 #include <fcitx-utils/utf8.h>
 #include <fcitx/addoninstance.h>
+#include <fcitx/candidatelist.h>
 #include <fcitx/event.h>
+#include <fcitx/globalconfig.h>
 #include <fcitx/inputcontext.h>
 #include <fcitx/inputcontextmanager.h>
 #include <fcitx/inputmethodentry.h>
-#include <stdexcept>
+#include <fcitx/inputpanel.h>
+#include <fcitx/instance.h>
+#include <fcitx/surroundingtext.h>
+#include <fcitx/text.h>
+#include <fcitx/userinterface.h>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <thai/thailib.h>
-#include <thai/thcell.h>
-#include <thai/thinp.h>
+#include <thai/thctype.h>
+#include <utility>
 #include <vector>
 
 namespace {
@@ -39,217 +64,1037 @@ namespace fcitx {
 #define LIBTHAI_DEBUG() FCITX_LOGC(libthai_log, Debug)
 
 constexpr auto FALLBACK_BUFF_SIZE = 4;
+// Enough for th_validate_leveled output, which is at most 3 characters.
+constexpr auto MAX_COMMIT_LENGTH = 4;
 
-class LibThaiState : public InputContextProperty {
+// Per input context state that is not used for this long is released.
+constexpr auto IDLE_TIMEOUT = std::chrono::minutes(5);
+constexpr uint64_t IDLE_CHECK_INTERVAL = 60 * 1000000;
+
+// Looked up in the user and system fcitx5 data directories.
+constexpr char PREDICTION_DICT_PATH[] = "libthai/prediction.dict";
+constexpr char CUSTOM_LAYOUT_DIR[] = "libthai/layouts/";
+constexpr char CUSTOM_LAYOUT_SUFFIX[] = ".kb";
+
+// Maximum byte length of a single UTF-8 sequence.
+constexpr size_t UTF8_MAX_LENGTH = 4;
+
+// Longest text kept in the preedit, a cell in Cell mode, or a word in Word
+// mode.
+constexpr size_t MAX_PREEDIT_LENGTH = 32;
+
+// Text kept to find the word prefix for prediction.
+constexpr size_t MAX_PREDICTION_CONTEXT = 32;
+
+// Longest text converted at once, the preedit plus a commit.
+constexpr size_t MAX_ENCODE_LENGTH =
+    (MAX_PREEDIT_LENGTH + MAX_COMMIT_LENGTH) * TIS_UTF8_MAX_LENGTH;
+
+namespace {
+
+// Calls the callback when the scope is left, on every return path.
+template <typename Callback>
+class ScopeExit {
+public:
+    explicit ScopeExit(Callback callback) : callback_(std::move(callback)) {}
+    ~ScopeExit() { callback_(); }
+
+    ScopeExit(const ScopeExit &) = delete;
+    ScopeExit &operator=(const ScopeExit &) = delete;
+
+private:
+    Callback callback_;
+};
+
+} // namespace
+
+// Return at most FALLBACK_BUFF_SIZE characters right before the cursor, or
+// before the selection if there is one. Only this tail is validated, so the
+// cost does not depend on how much text the client sends after the cursor.
+static std::string_view
+textBeforeCursor(const SurroundingText &surroundingText) {
+    if (!surroundingText.isValid()) {
+        return {};
+    }
+    std::string_view text = surroundingText.text();
+    auto cursor = std::min(surroundingText.cursor(), surroundingText.anchor());
+    // Cursor is counted in characters, and every character has at least one
+    // byte.
+    if (cursor > text.size()) {
+        return {};
+    }
+    // Only lead bytes are looked at to locate the cursor.
+    size_t end = utf8::ncharByteLength(text.begin(), cursor);
+    if (end > text.size()) {
+        return {};
+    }
+    size_t start = end;
+    for (int i = 0; i < FALLBACK_BUFF_SIZE && start > 0; i++) {
+        const size_t limit =
+            start > UTF8_MAX_LENGTH ? start - UTF8_MAX_LENGTH : 0;
+        do {
+            --start;
+        } while (start > limit &&
+                 (static_cast<uint8_t>(text[start]) & 0xC0) == 0x80);
+    }
+    text = text.substr(start, end - start);
+    if (utf8::lengthValidated(text) == utf8::INVALID_LENGTH) {
+        return {};
+    }
+    return text;
+}
+
+// Keeps a shadow of the last few characters before the cursor. It is updated
+// locally on every commit and deletion, and only reconciled with the
+// surrounding text when the client sends a new snapshot. Clients often update
+// surrounding text asynchronously, so the snapshot may still miss the last
+// commit when the next key arrives.
+class LibThaiState {
 public:
     LibThaiState(LibThaiEngine *engine, InputContext &ic)
         : engine_(engine), ic_(&ic) {}
 
-    ~LibThaiState() {}
+    // The shadow history packed into an integer, so it survives while the
+    // state is released: one character per byte, and the count in the top
+    // byte.
+    uint64_t packHistory() const {
+        const auto view = buffer_.view();
+        uint64_t packed = static_cast<uint64_t>(view.size) << 56;
+        for (size_t i = 0; i < view.size; i++) {
+            packed |= static_cast<uint64_t>(view.data[i]) << (8 * i);
+        }
+        return packed;
+    }
 
-    void rememberPrevChars(thchar_t newChar) {
-        if (buffer_.size() == FALLBACK_BUFF_SIZE) {
-            buffer_.pop_front();
+    void restoreHistory(uint64_t packed) {
+        thchar_t chars[FALLBACK_BUFF_SIZE];
+        const size_t size =
+            std::min<size_t>(packed >> 56, FALLBACK_BUFF_SIZE);
+        for (size_t i = 0; i < size; i++) {
+            chars[i] = (packed >> (8 * i)) & 0xFF;
         }
-        buffer_.push_back(newChar);
+        buffer_.assign(chars, size);
     }
 
-    bool commitString(thchar_t *chr, size_t length) {
-        auto s = engine_->convToUtf8().tryConvert(
-            std::string_view(reinterpret_cast<char *>(chr), length));
-        if (s.empty()) {
+    void touch(std::chrono::steady_clock::time_point time) {
+        lastUsed_ = time;
+    }
+    std::chrono::steady_clock::time_point lastUsed() const {
+        return lastUsed_;
+    }
+
+    void rememberPrevChars(const thchar_t *chr, size_t length) {
+        buffer_.append(chr, length);
+        recent_.append(chr, length);
+    }
+
+    bool commitString(const thchar_t *chr, size_t length) {
+        char buf[MAX_ENCODE_LENGTH];
+        std::string longBuf;
+        // Only a batch of keys commits more than the preedit at once.
+        const auto commit = length * TIS_UTF8_MAX_LENGTH <= MAX_ENCODE_LENGTH
+                                ? encode(chr, length, buf)
+                                : encode(chr, length, longBuf);
+        if (commit.empty()) {
             return false;
         }
-        std::string commit{s.begin(), s.end()};
         LIBTHAI_DEBUG() << "Commit String: " << commit;
-        ic_->commitString(commit);
+        ic_->commitString(std::string(commit));
+        rememberEditCursor();
+        rememberPrevChars(chr, length);
+        lastCommit_.assign(chr, length);
         return true;
     }
 
-    void forgetPrevChars() { buffer_.clear(); }
+    void deleteSurroundingText(int offset, unsigned int size) {
+        ic_->deleteSurroundingText(offset, size);
+        rememberEditCursor();
+        // Only deletion right before the cursor is ever requested.
+        if (offset < 0 && offset + static_cast<int>(size) == 0) {
+            buffer_.dropBack(size);
+            recent_.dropBack(size);
+        } else {
+            buffer_.clear();
+            recent_.clear();
+        }
+        lastCommit_.clear();
+    }
+
+    bool hasPreedit() const { return !preedit_.empty(); }
+
+    // Apply a commit action to the cell in the preedit. Corrections inside the
+    // cell are done locally, and only the text that leaves the preedit is sent
+    // to the client.
+    bool compose(const ThaiAction &action) {
+        const size_t localDelete =
+            std::min<size_t>(action.deleteCount, preedit_.size());
+        const bool hadPreedit = hasPreedit();
+        preedit_.dropBack(localDelete);
+        if (action.deleteCount > localDelete) {
+            const auto remoteDelete = action.deleteCount - localDelete;
+            deleteSurroundingText(-static_cast<int>(remoteDelete),
+                                  remoteDelete);
+        }
 
-    void prevCell(thcell_t *res) {
-        th_init_cell(res);
-        auto chars = prevChars();
-        if (!chars.empty()) {
-            th_prev_cell(chars.data(), chars.size(), res, true);
+        thchar_t text[MAX_PREEDIT_LENGTH + MAX_COMMIT_LENGTH];
+        const auto cell = preedit_.view();
+        std::memcpy(text, cell.data, cell.size);
+        std::memcpy(text + cell.size, action.commit, action.length);
+        const size_t length = cell.size + action.length;
+        auto pending = engine_->pendingLength({text, length});
+        if (pending > MAX_PREEDIT_LENGTH) {
+            // Too long for the preedit, only keep the last cell.
+            pending = std::min(
+                ThaiEngineCore::pendingCellLength({text, length}),
+                MAX_PREEDIT_LENGTH);
+        }
+
+        bool success = true;
+        if (pending < length) {
+            success = commitString(text, length - pending);
+        }
+        preedit_.assign(text + length - pending, pending);
+        if (hadPreedit || hasPreedit()) {
+            updatePreedit();
+        }
+        if (hasPreedit()) {
+            scheduleFlush();
         }
+        return success;
     }
 
-    std::vector<thchar_t> prevChars() {
-        if (ic_->capabilityFlags().test(CapabilityFlag::SurroundingText)) {
-            auto &surroundingText = ic_->surroundingText();
-            std::string_view text = surroundingText.text();
-            auto length = utf8::lengthValidated(text);
-            if (length == utf8::INVALID_LENGTH) {
-                return {};
-            }
+    // Remove the last character of the preedit, for BackSpace.
+    void dropPreeditChar() {
+        preedit_.dropBack(1);
+        updatePreedit();
+    }
 
-            if (length > FALLBACK_BUFF_SIZE) {
-                auto byte = utf8::ncharByteLength(text.begin(),
-                                                  length - FALLBACK_BUFF_SIZE);
-                text = text.substr(byte);
-            }
-            LIBTHAI_DEBUG() << "SurroundingText is: " << text;
-            return engine_->convFromUtf8().tryConvert(text);
+    void commitPreedit() {
+        if (!hasPreedit()) {
+            return;
+        }
+        const auto cell = preedit_.view();
+        thchar_t text[MAX_PREEDIT_LENGTH];
+        std::memcpy(text, cell.data, cell.size);
+        preedit_.clear();
+        commitString(text, cell.size);
+        updatePreedit();
+    }
+
+    // The client inserts the text of a key that was passed through, so the
+    // shadow no longer ends at the cursor. Unlike forgetPrevChars the recent
+    // text is kept, it only feeds prediction.
+    void clientTextChanged() {
+        buffer_.clear();
+        lastCommit_.clear();
+        snapshotPending_ = true;
+    }
+
+    void forgetPrevChars() {
+        buffer_.clear();
+        recent_.clear();
+        lastCommit_.clear();
+        lastCheckedWord_.clear();
+        snapshotPending_ = true;
+        setUnknownWord({});
+    }
+
+    // The window of recent text is full, so its first word may be cut.
+    bool recentTruncated() const {
+        return recent_.size() == MAX_PREDICTION_CONTEXT;
+    }
+
+    // A complete word is only checked once, returns false if word was the
+    // last one checked.
+    bool markWordChecked(ThaiContextView word) {
+        if (lastCheckedWord_.size() == word.size &&
+            lastCheckedWord_.view().endsWith(word)) {
+            return false;
         }
-        return {buffer_.begin(), buffer_.end()};
+        lastCheckedWord_.assign(word.data, word.size);
+        return true;
+    }
+
+    // Show word as not found in the dictionary, or hide the hint if word is
+    // empty.
+    void setUnknownWord(ThaiContextView word) {
+        if (word.empty() && !unknownWordShown_) {
+            return;
+        }
+        Text aux;
+        if (!word.empty()) {
+            char buf[MAX_ENCODE_LENGTH];
+            const auto utf8 = encode(word.data, word.size, buf);
+            aux.append(_("Unknown word: "));
+            aux.append(std::string(utf8), TextFormatFlag::Underline);
+        }
+        unknownWordShown_ = !word.empty();
+        ic_->inputPanel().setAuxUp(aux);
+        ic_->updateUserInterface(UserInterfaceComponent::InputPanel);
+    }
+
+    // Called when the client sends new surrounding text.
+    void surroundingTextUpdated() { snapshotPending_ = true; }
+
+    LibThaiStats &stats() { return stats_; }
+
+    // Recently typed text including the preedit, longer than prevChars so
+    // that it covers a whole word. It is not reconciled with the surrounding
+    // text.
+    ThaiContextView predictionContext() {
+        const auto committed = recent_.view();
+        const auto cell = preedit_.view();
+        std::memcpy(predictionContext_, committed.data, committed.size);
+        std::memcpy(predictionContext_ + committed.size, cell.data, cell.size);
+        return {predictionContext_, committed.size + cell.size};
+    }
+
+    // The text before the cursor, including the preedit.
+    ThaiContextView prevChars() {
+        if (snapshotPending_ &&
+            ic_->capabilityFlags().test(CapabilityFlag::SurroundingText)) {
+            reconcile();
+        }
+        if (preedit_.empty()) {
+            return buffer_.view();
+        }
+        const auto committed = buffer_.view();
+        const auto cell = preedit_.view();
+        std::memcpy(context_, committed.data, committed.size);
+        std::memcpy(context_ + committed.size, cell.data, cell.size);
+        return {context_, committed.size + cell.size};
     }
 
 private:
+    template <size_t N>
+    std::string_view encode(const thchar_t *chr, size_t length,
+                            char (&buf)[N]) {
+        auto written = ThaiTisToUtf8(chr, length, buf, N);
+        if (written != THAI_CODEC_ERROR) {
+            return {buf, written};
+        }
+        // Only reached for input the table does not cover.
+        const auto *conv = engine_->convToUtf8();
+        if (!conv) {
+            return {};
+        }
+        auto converted = conv->convert(
+            std::string_view(reinterpret_cast<const char *>(chr), length));
+        if (converted.ok()) {
+            return converted.output;
+        }
+        return {};
+    }
+
+    std::string_view encode(const thchar_t *chr, size_t length,
+                            std::string &buf) {
+        buf.resize(length * TIS_UTF8_MAX_LENGTH);
+        auto written = ThaiTisToUtf8(chr, length, buf.data(), buf.size());
+        if (written != THAI_CODEC_ERROR) {
+            buf.resize(written);
+            return buf;
+        }
+        const auto *conv = engine_->convToUtf8();
+        if (!conv) {
+            return {};
+        }
+        auto converted = conv->convert(
+            std::string_view(reinterpret_cast<const char *>(chr), length));
+        if (converted.ok()) {
+            return converted.output;
+        }
+        return {};
+    }
+
+    // Commit the word if no other key arrives before the timeout.
+    void scheduleFlush() {
+        const auto &config = engine_->config();
+        if (*config.commitMode != ThaiCommitMode::Word ||
+            *config.wordCommitTimeout <= 0) {
+            return;
+        }
+        const uint64_t usec =
+            static_cast<uint64_t>(*config.wordCommitTimeout) * 1000;
+        if (flushTimer_) {
+            flushTimer_->setNextInterval(usec);
+            flushTimer_->setOneShot();
+            return;
+        }
+        flushTimer_ = engine_->instance()->eventLoop().addTimeEvent(
+            CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + usec, 0,
+            [this](EventSourceTime * /*source*/, uint64_t /*usec*/) {
+                commitPreedit();
+                return true;
+            });
+    }
+
+    void updatePreedit() {
+        Text text;
+        if (!preedit_.empty()) {
+            char buf[MAX_ENCODE_LENGTH];
+            const auto cell = preedit_.view();
+            const auto utf8 = encode(cell.data, cell.size, buf);
+            text.append(std::string(utf8), TextFormatFlag::Underline);
+            text.setCursor(utf8.size());
+        }
+        if (ic_->capabilityFlags().test(CapabilityFlag::Preedit)) {
+            ic_->inputPanel().setClientPreedit(text);
+            ic_->updatePreedit();
+        } else {
+            ic_->inputPanel().setPreedit(text);
+            ic_->updateUserInterface(UserInterfaceComponent::InputPanel);
+        }
+    }
+
+    // The cursor of the last snapshot is where the client still was when
+    // we edited the text.
+    void rememberEditCursor() {
+        const auto &surroundingText = ic_->surroundingText();
+        if (surroundingText.isValid()) {
+            editCursor_ = surroundingText.cursor();
+        } else {
+            editCursor_.reset();
+        }
+    }
+
+    void reconcile() {
+        snapshotPending_ = false;
+        // Nothing to compare with, the shadow is all we know.
+        if (!ic_->surroundingText().isValid()) {
+            return;
+        }
+        thchar_t snapshot[FALLBACK_BUFF_SIZE];
+        auto size = decodeSurroundingText(snapshot, FALLBACK_BUFF_SIZE);
+        // The first snapshot after an edit may have been taken before the
+        // client applied it: the cursor has not moved and the text does not
+        // end with our last commit. Keep the local shadow for that one only.
+        // Anything else, e.g. the cursor moved by a mouse click, is adopted.
+        const bool stale =
+            editCursor_ &&
+            ic_->surroundingText().cursor() == *editCursor_ &&
+            !ThaiContextView{snapshot, size}.endsWith(lastCommit_.view());
+        editCursor_.reset();
+        if (stale) {
+            LIBTHAI_DEBUG() << "Ignore stale surrounding text.";
+            return;
+        }
+        lastCommit_.clear();
+        buffer_.assign(snapshot, size);
+    }
+
+    size_t decodeSurroundingText(thchar_t *out, size_t outLength) {
+        auto &surroundingText = ic_->surroundingText();
+        auto text = textBeforeCursor(surroundingText);
+        LIBTHAI_DEBUG() << "SurroundingText is: " << text;
+        auto written = ThaiUtf8ToTis(text, out, outLength);
+        if (written != THAI_CODEC_ERROR) {
+            return written;
+        }
+        const auto *conv = engine_->convFromUtf8();
+        if (!conv) {
+            return 0;
+        }
+        // Keep unknown characters as a placeholder so they still break the
+        // cell, instead of dropping the whole context.
+        auto converted = conv->convert(text, IconvErrorPolicy::Substitute);
+        // Every character converts to at most one byte, keep the tail.
+        auto result = converted.output.substr(
+            converted.output.size() - std::min(converted.output.size(),
+                                               outLength));
+        std::memcpy(out, result.data(), result.size());
+        return result.size();
+    }
+
     LibThaiEngine *engine_;
     InputContext *ic_;
-    std::deque<uint8_t> buffer_;
+    ThaiHistory<FALLBACK_BUFF_SIZE> buffer_;
+    // Last committed characters not yet seen in a surrounding text snapshot.
+    ThaiHistory<FALLBACK_BUFF_SIZE> lastCommit_;
+    // Cursor of the client before the last edit, until the next snapshot.
+    std::optional<unsigned int> editCursor_;
+    // The cell being composed in Cell commit mode.
+    ThaiHistory<MAX_PREEDIT_LENGTH> preedit_;
+    thchar_t context_[FALLBACK_BUFF_SIZE + MAX_PREEDIT_LENGTH];
+    ThaiHistory<MAX_PREDICTION_CONTEXT> recent_;
+    ThaiHistory<MAX_PREDICTION_CONTEXT> lastCheckedWord_;
+    bool unknownWordShown_ = false;
+    thchar_t predictionContext_[MAX_PREDICTION_CONTEXT + MAX_PREEDIT_LENGTH];
+    std::unique_ptr<EventSourceTime> flushTimer_;
+    std::chrono::steady_clock::time_point lastUsed_;
+    bool snapshotPending_ = true;
+    LibThaiStats stats_;
+};
+
+static_assert(FALLBACK_BUFF_SIZE < 8, "History does not fit in 64 bits");
+
+// The property attached to every input context, so it is kept to a few
+// bytes. LibThaiState is only allocated once libthai handles a key for the
+// input context, and is released again on deactivate or when it is idle.
+class LibThaiStateHolder : public InputContextProperty {
+public:
+    LibThaiState *get() const { return state_.get(); }
+
+    LibThaiState *acquire(LibThaiEngine *engine, InputContext &ic) {
+        if (!state_) {
+            state_ = std::make_unique<LibThaiState>(engine, ic);
+            state_->restoreHistory(packedHistory_);
+        }
+        return state_.get();
+    }
+
+    void release() {
+        if (state_) {
+            packedHistory_ = state_->packHistory();
+            state_.reset();
+        }
+    }
+
+private:
+    std::unique_ptr<LibThaiState> state_;
+    uint64_t packedHistory_ = 0;
+};
+
+class ThaiPredictionCandidateWord : public CandidateWord {
+public:
+    ThaiPredictionCandidateWord(LibThaiEngine *engine, std::string word,
+                                std::string remainder)
+        : CandidateWord(Text(std::move(word))), engine_(engine),
+          remainder_(std::move(remainder)) {}
+
+    void select(InputContext *inputContext) const override {
+        engine_->commitPrediction(inputContext, remainder_);
+    }
+
+private:
+    LibThaiEngine *engine_;
+    // TIS-620 text after the typed prefix.
+    std::string remainder_;
 };
 
+// Digits are Thai characters in most layouts, so predictions are picked with
+// Alt.
+static const KeyList &predictionSelectionKeys() {
+    static const KeyList keys = []() {
+        KeyList keys;
+        for (KeySym sym = FcitxKey_1; sym <= FcitxKey_9;
+             sym = static_cast<KeySym>(sym + 1)) {
+            keys.emplace_back(sym, KeyState::Alt);
+        }
+        return keys;
+    }();
+    return keys;
+}
+
+// Open the converter on first use. Only text the built in TIS-620 table does
+// not cover ever goes through iconv.
+static const IconvWrapper *
+openConverter(std::unique_ptr<IconvWrapper> &conv, const char *from,
+              const char *to) {
+    if (!conv) {
+        conv = std::make_unique<IconvWrapper>(from, to);
+        if (!*conv) {
+            FCITX_LOGC(libthai_log, Warn)
+                << "Failed to open iconv from " << from << " to " << to;
+        }
+    }
+    return *conv ? conv.get() : nullptr;
+}
+
 LibThaiEngine::LibThaiEngine(Instance *instance)
-    : instance_(instance), convFromUtf8_("UTF-8", "TIS-620"),
-      convToUtf8_("TIS-620", "UTF-8"), factory_([this](InputContext &ic) {
-          return new LibThaiState(this, ic);
+    : instance_(instance), factory_([](InputContext & /*ic*/) {
+          return new LibThaiStateHolder;
       }) {
+    if (getenv("FCITX_LIBTHAI_TRACE")) {
+        tracer_.setEnabled(true);
+    }
+}
+
+LibThaiEngine::~LibThaiEngine() {}
 
-    if (!convFromUtf8_ || !convToUtf8_) {
-        throw std::runtime_error("Failed to open iconv for libthai");
+void LibThaiEngine::initialize() {
+    if (core_) {
+        return;
     }
+    core_ = std::make_unique<ThaiEngineCore>();
+    core_->setTracer(&tracer_);
+    ensureConfigLoaded();
+    updateCoreConfig();
     instance_->inputContextManager().registerProperty("libthaiState",
                                                       &factory_);
-    reloadConfig();
+    eventWatchers_.emplace_back(instance_->watchEvent(
+        EventType::InputContextSurroundingTextUpdated,
+        EventWatcherPhase::Default, [this](Event &event) {
+            auto &icEvent = static_cast<InputContextEvent &>(event);
+            if (auto *state = findState(icEvent.inputContext())) {
+                state->surroundingTextUpdated();
+            }
+        }));
+    idleTimer_ = instance_->eventLoop().addTimeEvent(
+        CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + IDLE_CHECK_INTERVAL, 0,
+        [this](EventSourceTime *source, uint64_t /*usec*/) {
+            releaseIdleStates();
+            source->setNextInterval(IDLE_CHECK_INTERVAL);
+            source->setOneShot();
+            return true;
+        });
 }
 
-LibThaiEngine::~LibThaiEngine() {}
+LibThaiState *LibThaiEngine::state(InputContext *ic) {
+    return ic->propertyFor(&factory_)->acquire(this, *ic);
+}
 
-void LibThaiEngine::activate(const InputMethodEntry & /*entry*/,
-                             InputContextEvent & /*event*/) {}
+LibThaiState *LibThaiEngine::findState(InputContext *ic) {
+    if (!core_) {
+        return nullptr;
+    }
+    return ic->propertyFor(&factory_)->get();
+}
 
-void LibThaiEngine::deactivate(const InputMethodEntry & /*entry*/,
-                               InputContextEvent & /*event*/) {}
+void LibThaiEngine::releaseIdleStates() {
+    const auto idleSince = std::chrono::steady_clock::now() - IDLE_TIMEOUT;
+    instance_->inputContextManager().foreach(
+        [this, idleSince](InputContext *ic) {
+            auto *holder = ic->propertyFor(&factory_);
+            auto *state = holder->get();
+            // A pending preedit is committed by its own timer or the next
+            // key.
+            if (state && !state->hasPreedit() &&
+                state->lastUsed() < idleSince) {
+                holder->release();
+            }
+            return true;
+        });
+}
 
-static bool isContextIntactKey(Key key) {
+const IconvWrapper *LibThaiEngine::convFromUtf8() {
+    return openConverter(convFromUtf8_, "UTF-8", "TIS-620");
+}
 
-    return (((key.sym() & 0xFF00) == 0xFF00) &&
-            (/* IsModifierKey */
-             key.isModifier() || (key.sym() == FcitxKey_Mode_switch) ||
-             (key.sym() == FcitxKey_Num_Lock))) ||
-           (((key.sym() & 0xFE00) == 0xFE00) &&
-            (FcitxKey_ISO_Lock <= key.sym() &&
-             key.sym() <= FcitxKey_ISO_Last_Group_Lock));
+const IconvWrapper *LibThaiEngine::convToUtf8() {
+    return openConverter(convToUtf8_, "TIS-620", "UTF-8");
 }
 
-static bool isContextLostKey(Key key) {
-
-    return ((key.sym() & 0xFF00) == 0xFF00) &&
-           (key.sym() == FcitxKey_BackSpace || key.sym() == FcitxKey_Tab ||
-            key.sym() == FcitxKey_Linefeed || key.sym() == FcitxKey_Clear ||
-            key.sym() == FcitxKey_Return || key.sym() == FcitxKey_Pause ||
-            key.sym() == FcitxKey_Scroll_Lock ||
-            key.sym() == FcitxKey_Sys_Req || key.sym() == FcitxKey_Escape ||
-            key.sym() == FcitxKey_Delete ||
-            /* IsCursorkey */
-            (FcitxKey_Home <= key.sym() && key.sym() <= FcitxKey_Begin) ||
-            /* IsKeypadKey, non-chars only */
-            (FcitxKey_KP_Space <= key.sym() &&
-             key.sym() <= FcitxKey_KP_Delete) ||
-            /* IsMiscFunctionKey */
-            (FcitxKey_Select <= key.sym() && key.sym() <= FcitxKey_Break) ||
-            /* IsFunctionKey */
-            (FcitxKey_F1 <= key.sym() && key.sym() <= FcitxKey_F35));
+void LibThaiEngine::activate(const InputMethodEntry & /*entry*/,
+                             InputContextEvent & /*event*/) {
+    initialize();
+}
+
+void LibThaiEngine::deactivate(const InputMethodEntry & /*entry*/,
+                               InputContextEvent &event) {
+    auto *state = findState(event.inputContext());
+    if (!state) {
+        return;
+    }
+    state->commitPreedit();
+    event.inputContext()->propertyFor(&factory_)->release();
 }
 
 void LibThaiEngine::keyEvent(const InputMethodEntry & /*entry*/,
                              KeyEvent &keyEvent) {
-    auto key = keyEvent.rawKey();
     if (keyEvent.isRelease()) {
         return;
     }
-    auto *state = keyEvent.inputContext()->propertyFor(&factory_);
-    // If any ctrl alt super modifier is pressed, ignore.
-    if (key.states().testAny(KeyStates{KeyState::Ctrl_Alt, KeyState::Super}) ||
-        isContextLostKey(key)) {
-        state->forgetPrevChars();
-        return;
+    // Normally done by activate, keys may be sent directly.
+    initialize();
+    const auto start = std::chrono::steady_clock::now();
+    if (tracer_.enabled()) {
+        tracer_.beginKey();
     }
-    if (key.sym() == FcitxKey_None || isContextIntactKey(key)) {
+    ThaiTraceSpan keySpan(&tracer_, ThaiTracePhase::KeyEvent);
+    const auto &key = keyEvent.rawKey();
+    auto *ic = keyEvent.inputContext();
+    auto *state = this->state(ic);
+    state->touch(start);
+    auto count = [this, state](LibThaiCounter counter) {
+        stats_.count(counter);
+        state->stats().counters[static_cast<size_t>(counter)]++;
+    };
+    auto counter = LibThaiCounter::Passed;
+    // Every key press is accounted for, whichever way it is handled.
+    ScopeExit recordKey([this, state, start, &count, &counter]() {
+        count(LibThaiCounter::Keys);
+        count(counter);
+        const auto latency = std::chrono::steady_clock::now() - start;
+        stats_.recordLatency(latency);
+        state->stats().latency[latencyBucket(latency)]++;
+    });
+
+    if (keyEvent.key().checkKeyList(*config_.pasteNormalizedKeys) &&
+        pasteNormalized(ic, state)) {
+        counter = LibThaiCounter::Committed;
+        keyEvent.filterAndAccept();
         return;
     }
-    int shiftLevel;
-    uint8_t newChar;
-
-    // Calculate shift level based on shift and mod5.
-    if (!key.states().testAny(KeyStates({KeyState::Shift, KeyState::Mod5}))) {
-        shiftLevel = 0;
-    } else {
-        if (key.states().test(KeyState::Mod5)) {
-            shiftLevel = 2;
-        } else {
-            shiftLevel = 1;
+    if (auto candidateList = ic->inputPanel().candidateList()) {
+        const int index =
+            keyEvent.key().keyListIndex(predictionSelectionKeys());
+        if (index >= 0 && index < candidateList->size()) {
+            counter = LibThaiCounter::Committed;
+            candidateList->candidate(index).select(ic);
+            keyEvent.filterAndAccept();
+            return;
         }
     }
 
-    // Keypad is handled separately.
-    if ((FcitxKey_KP_0 <= key.sym()) && (key.sym() <= FcitxKey_KP_9) &&
-        key.states().test(KeyState::NumLock) &&
-        ((2 == shiftLevel) || (key.states().test(KeyState::CapsLock)))) {
-        newChar = key.sym() - FcitxKey_KP_0 + 0xf0;
-    } else {
-        // Make sure we remove evdev offset 8 from the key code.
-        newChar =
-            ThaiKeycodeToChar(*config_.keyboardMap, key.code() - 8, shiftLevel);
-        if (0 == newChar) {
-            return;
-        }
+    ThaiContextView context;
+    {
+        ThaiTraceSpan span(&tracer_, ThaiTracePhase::SurroundingText);
+        context = state->prevChars();
     }
-    LIBTHAI_DEBUG() << key.toString() << " ShiftLevel: " << shiftLevel
-                    << " New Char: " << static_cast<int>(newChar);
+    const ThaiKeyDescriptor descriptor{key.sym(), key.states(), key.code()};
+    // Characters in the preedit can always be corrected locally.
+    const auto action = core_->processKey(
+        descriptor, context,
+        ic->capabilityFlags().test(CapabilityFlag::SurroundingText) ||
+            state->hasPreedit());
+    LIBTHAI_DEBUG() << key.toString()
+                    << " Action: " << static_cast<int>(action.type);
 
-    // No correction -> just reject or commit
-    if (!*config_.correction) {
-        auto prevChars = state->prevChars();
-        thchar_t prevChar = 0;
-        if (!prevChars.empty()) {
-            prevChar = prevChars.back();
+    switch (action.type) {
+    case ThaiActionType::Pass:
+        if (!ThaiEngineCore::isContextIntactKey(descriptor)) {
+            state->commitPreedit();
+            state->clientTextChanged();
+            clearPrediction(ic);
         }
-        if (!th_isaccept(prevChar, newChar, *config_.strictness)) {
+        break;
+    case ThaiActionType::ForgetContext:
+        if (state->hasPreedit() && keyEvent.key().check(FcitxKey_BackSpace)) {
+            counter = LibThaiCounter::Filtered;
+            state->dropPreeditChar();
+            updatePrediction(ic, state);
             keyEvent.filterAndAccept();
-            return;
+            break;
+        }
+        counter = LibThaiCounter::ContextLost;
+        state->commitPreedit();
+        state->forgetPrevChars();
+        clearPrediction(ic);
+        break;
+    case ThaiActionType::Reject:
+        counter = LibThaiCounter::Rejected;
+        keyEvent.filterAndAccept();
+        break;
+    case ThaiActionType::Filter:
+        counter = LibThaiCounter::Filtered;
+        // SurroundingText not supported, so just reject the key.
+        keyEvent.filter();
+        break;
+    case ThaiActionType::Commit: {
+        if (action.deleteCount) {
+            count(LibThaiCounter::Corrections);
         }
-        if (state->commitString(&newChar, 1)) {
+        const bool composing =
+            core_->config().commitMode != ThaiCommitMode::Immediate;
+        bool committed;
+        if (composing || state->hasPreedit()) {
+            ThaiTraceSpan span(&tracer_, ThaiTracePhase::Commit);
+            committed = state->compose(action);
+            // Left over from before the commit mode was changed.
+            if (!composing) {
+                state->commitPreedit();
+            }
+        } else {
+            if (action.deleteCount) {
+                ThaiTraceSpan span(&tracer_,
+                                   ThaiTracePhase::DeleteSurroundingText);
+                state->deleteSurroundingText(
+                    -static_cast<int>(action.deleteCount), action.deleteCount);
+            }
+            ThaiTraceSpan span(&tracer_, ThaiTracePhase::Commit);
+            committed = state->commitString(action.commit, action.length);
+        }
+        if (committed) {
+            counter = LibThaiCounter::Committed;
+            updatePrediction(ic, state);
+            checkSpelling(state);
             keyEvent.filterAndAccept();
+        } else {
+            counter = LibThaiCounter::CommitFailures;
+        }
+        break;
+    }
+    }
+}
+
+size_t LibThaiEngine::processKeys(InputContext *ic,
+                                  const std::vector<Key> &keys) {
+    initialize();
+    auto *state = this->state(ic);
+    state->touch(std::chrono::steady_clock::now());
+    // The batch is committed as a whole, the preedit would be in the way.
+    state->commitPreedit();
+    clearPrediction(ic);
+
+    const auto context = state->prevChars();
+    std::vector<thchar_t> text(context.data, context.data + context.size);
+    text.reserve(context.size + keys.size() * MAX_COMMIT_LENGTH);
+    // Characters of text that the client already has.
+    size_t committed = context.size;
+    size_t remoteDelete = 0;
+    const bool canDelete =
+        ic->capabilityFlags().test(CapabilityFlag::SurroundingText);
+
+    auto count = [this, state](LibThaiCounter counter) {
+        stats_.count(counter);
+        state->stats().counters[static_cast<size_t>(counter)]++;
+    };
+    size_t consumed = 0;
+    for (const auto &key : keys) {
+        const ThaiKeyDescriptor descriptor{key.sym(), key.states(), key.code()};
+        // Deleting text of the batch itself is always possible.
+        const auto action =
+            core_->processKey(descriptor, {text.data(), text.size()}, true);
+        LibThaiCounter counter;
+        if (action.type == ThaiActionType::Reject) {
+            counter = LibThaiCounter::Rejected;
+        } else if (action.type == ThaiActionType::Commit &&
+                   (canDelete ||
+                    action.deleteCount <= text.size() - committed)) {
+            counter = LibThaiCounter::Committed;
+            if (action.deleteCount) {
+                count(LibThaiCounter::Corrections);
+            }
+            text.resize(text.size() - action.deleteCount);
+            if (text.size() < committed) {
+                remoteDelete += committed - text.size();
+                committed = text.size();
+            }
+            text.insert(text.end(), action.commit,
+                        action.commit + action.length);
+        } else if (action.type == ThaiActionType::Pass &&
+                   ThaiEngineCore::isContextIntactKey(descriptor)) {
+            counter = LibThaiCounter::Passed;
+        } else {
+            // Leave this key to the caller, so that it reaches the client
+            // after the text before it.
+            break;
         }
+        count(LibThaiCounter::Keys);
+        count(counter);
+        consumed++;
+    }
+
+    if (remoteDelete) {
+        ThaiTraceSpan span(&tracer_, ThaiTracePhase::DeleteSurroundingText);
+        state->deleteSurroundingText(-static_cast<int>(remoteDelete),
+                                     remoteDelete);
+    }
+    if (text.size() > committed) {
+        ThaiTraceSpan span(&tracer_, ThaiTracePhase::Commit);
+        if (!state->commitString(text.data() + committed,
+                                 text.size() - committed)) {
+            count(LibThaiCounter::CommitFailures);
+        }
+        checkSpelling(state);
+    }
+    return consumed;
+}
+
+bool LibThaiEngine::pasteNormalized(InputContext *ic, LibThaiState *state) {
+    auto *clipboard = this->clipboard();
+    if (!clipboard) {
+        return false;
+    }
+    const auto text = clipboard->call<IClipboard::clipboard>(ic);
+    if (text.empty()) {
+        return false;
+    }
+    state->commitPreedit();
+    clearPrediction(ic);
+    ic->commitString(ThaiNormalizeText(text));
+    // The pasted text is not tracked, wait for the next surrounding text.
+    state->forgetPrevChars();
+    return true;
+}
+
+void LibThaiEngine::updateCoreConfig() {
+    if (!core_) {
         return;
     }
+    ThaiCoreConfig config{*config_.keyboardMap, *config_.correction,
+                          *config_.strictness, *config_.commitMode};
+    if (config.keyboardMap == ThaiKBMap::Custom) {
+        config.customKeys = customKeys();
+    }
+    core_->setConfig(config);
+}
 
-    thinpconv_t conv;
-    thcell_t contextCell;
-    state->prevCell(&contextCell);
-    if (!th_validate_leveled(contextCell, newChar, &conv,
-                             *config_.strictness)) {
-        keyEvent.filterAndAccept();
+ThaiKeyTable LibThaiEngine::customKeys() {
+    const auto &name = *config_.customLayout;
+    if (customLayoutName_ == name) {
+        return customLayout_.keys();
+    }
+    customLayoutName_ = name;
+    customLayout_.close();
+    if (name.empty() || name.find('/') != std::string::npos) {
+        FCITX_LOGC(libthai_log, Warn)
+            << "Invalid custom keyboard layout name: " << name;
+        return nullptr;
+    }
+    const auto file =
+        stringutils::concat(CUSTOM_LAYOUT_DIR, name, CUSTOM_LAYOUT_SUFFIX);
+    const auto path =
+        StandardPaths::global().locate(StandardPathsType::PkgData, file);
+    if (path.empty() || !customLayout_.open(path.string())) {
+        FCITX_LOGC(libthai_log, Warn)
+            << "Failed to load keyboard layout " << file
+            << ", falling back to KETMANEE";
+    }
+    return customLayout_.keys();
+}
+
+const ThaiPredictionDict *LibThaiEngine::predictionDict() {
+    if (!predictionDictLoaded_) {
+        predictionDictLoaded_ = true;
+        const auto path = StandardPaths::global().locate(
+            StandardPathsType::PkgData, PREDICTION_DICT_PATH);
+        if (path.empty() || !predictionDict_.open(path.string())) {
+            FCITX_LOGC(libthai_log, Warn)
+                << "Failed to load prediction dictionary "
+                << PREDICTION_DICT_PATH;
+        }
+    }
+    return predictionDict_.isOpen() ? &predictionDict_ : nullptr;
+}
+
+void LibThaiEngine::updatePrediction(InputContext *ic, LibThaiState *state) {
+    const auto *dict = *config_.prediction ? predictionDict() : nullptr;
+    if (!dict) {
+        clearPrediction(ic);
+        return;
+    }
+    const auto context = state->predictionContext();
+    const auto prefixLength = core_->pendingWordLength(context);
+    if (!prefixLength) {
+        clearPrediction(ic);
+        return;
+    }
+    const std::string_view prefix(
+        reinterpret_cast<const char *>(context.data) + context.size -
+            prefixLength,
+        prefixLength);
+    const auto pageSize = std::min<size_t>(
+        instance_->globalConfig().defaultPageSize(),
+        predictionSelectionKeys().size());
+    const auto predictions = dict->predict(prefix, pageSize);
+    if (predictions.empty()) {
+        clearPrediction(ic);
         return;
     }
 
-    if (conv.offset < 0) {
-        // SurroundingText not supported, so just reject the key.
-        if (!keyEvent.inputContext()->capabilityFlags().test(
-                CapabilityFlag::SurroundingText)) {
-            keyEvent.filter();
-            return;
+    auto candidateList = std::make_unique<CommonCandidateList>();
+    candidateList->setPageSize(pageSize);
+    candidateList->setLayoutHint(CandidateLayoutHint::Horizontal);
+    std::vector<std::string> labels;
+    for (size_t i = 0; i < predictions.size(); i++) {
+        labels.push_back(std::to_string(i + 1) + ". ");
+    }
+    candidateList->setLabels(labels);
+    for (const auto &prediction : predictions) {
+        std::string word(prediction.word.size() * TIS_UTF8_MAX_LENGTH, '\0');
+        const auto length = ThaiTisToUtf8(
+            reinterpret_cast<const uint8_t *>(prediction.word.data()),
+            prediction.word.size(), word.data(), word.size());
+        if (length == THAI_CODEC_ERROR) {
+            continue;
         }
+        word.resize(length);
+        candidateList->append<ThaiPredictionCandidateWord>(
+            this, std::move(word),
+            std::string(prediction.word.substr(prefix.size())));
+    }
+    ic->inputPanel().setCandidateList(std::move(candidateList));
+    ic->updateUserInterface(UserInterfaceComponent::InputPanel);
+}
 
-        keyEvent.inputContext()->deleteSurroundingText(conv.offset,
-                                                       -conv.offset);
+void LibThaiEngine::checkSpelling(LibThaiState *state) {
+    const auto *dict = *config_.spellCheck ? predictionDict() : nullptr;
+    if (!dict) {
+        return;
     }
-    state->forgetPrevChars();
-    state->rememberPrevChars(newChar);
-    if (state->commitString(conv.conv,
-                            strlen(reinterpret_cast<char *>(conv.conv)))) {
-        keyEvent.filterAndAccept();
+    // Only the recent text is segmented, so the cost does not depend on the
+    // size of the document.
+    const auto context = state->predictionContext();
+    const auto range = core_->lastCompleteWord(context);
+    if (range.empty() || (range.begin == 0 && state->recentTruncated())) {
+        return;
+    }
+    const ThaiContextView word{context.data + range.begin, range.size()};
+    if (!state->markWordChecked(word)) {
+        return;
+    }
+    const std::string_view key(reinterpret_cast<const char *>(word.data),
+                               word.size);
+    // Words with digits are numbers, not misspellings.
+    const bool isNumber =
+        std::any_of(word.data, word.data + word.size,
+                    [](thchar_t c) { return th_isthdigit(c); });
+    if (isNumber || dict->contains(key)) {
+        state->setUnknownWord({});
+    } else {
+        LIBTHAI_DEBUG() << "Unknown word of length " << word.size;
+        state->setUnknownWord(word);
+    }
+}
+
+void LibThaiEngine::clearPrediction(InputContext *ic) {
+    if (!ic->inputPanel().candidateList()) {
+        return;
+    }
+    ic->inputPanel().setCandidateList(nullptr);
+    ic->updateUserInterface(UserInterfaceComponent::InputPanel);
+}
+
+void LibThaiEngine::commitPrediction(InputContext *ic,
+                                     std::string_view remainder) {
+    auto *state = this->state(ic);
+    state->commitPreedit();
+    state->commitString(reinterpret_cast<const thchar_t *>(remainder.data()),
+                        remainder.size());
+    clearPrediction(ic);
+}
+
+size_t LibThaiEngine::pendingLength(ThaiContextView text) {
+    switch (core_->config().commitMode) {
+    case ThaiCommitMode::Immediate:
+        break;
+    case ThaiCommitMode::Cell:
+        return ThaiEngineCore::pendingCellLength(text);
+    case ThaiCommitMode::Word:
+        return core_->pendingWordLength(text);
+    }
+    return 0;
+}
+
+LibThaiStats LibThaiEngine::inputContextStats(InputContext *ic) {
+    if (auto *state = findState(ic)) {
+        return state->stats();
+    }
+    return {};
+}
+
+void LibThaiEngine::resetStats() {
+    stats_.reset();
+    if (!core_) {
         return;
     }
+    instance_->inputContextManager().foreach([this](InputContext *ic) {
+        if (auto *state = findState(ic)) {
+            state->stats() = LibThaiStats();
+        }
+        return true;
+    });
 }
 
 void LibThaiEngine::reset(const InputMethodEntry & /*entry*/,
                           InputContextEvent &event) {
-    auto *state = event.inputContext()->propertyFor(&factory_);
+    clearPrediction(event.inputContext());
+    auto *state = findState(event.inputContext());
+    if (!state) {
+        return;
+    }
+    state->commitPreedit();
     state->forgetPrevChars();
 }
 
@@ -7,13 +7,24 @@
 #ifndef _FCITX5_LIBTHAI_ENGINE_H_
 #define _FCITX5_LIBTHAI_ENGINE_H_
 
+#include "configwriter.h"
 #include "iconvwrapper.h"
+#include "libthai_public.h"
+#include "thaicontext.h"
+#include "thaicore.h"
 #include "thaikb.h"
+#include "thaikblayout.h"
+#include "thainormalizer.h"
+#include "thaiprediction.h"
+#include "thaistats.h"
+#include "thaitrace.h"
 #include <fcitx-config/configuration.h>
 #include <fcitx-config/enum.h>
 #include <fcitx-config/iniparser.h>
 #include <fcitx-config/option.h>
 #include <fcitx-config/rawconfig.h>
+#include <fcitx-utils/event.h>
+#include <fcitx-utils/handlertable.h>
 #include <fcitx-utils/i18n.h>
 #include <fcitx/addonfactory.h>
 #include <fcitx/addoninstance.h>
@@ -22,26 +33,55 @@
 #include <fcitx/inputcontextproperty.h>
 #include <fcitx/inputmethodengine.h>
 #include <fcitx/instance.h>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <thai/thinp.h>
+#include <utility>
+#include <vector>
 
 namespace fcitx {
 
 FCITX_CONFIG_ENUM_NAME_WITH_I18N(ThaiKBMap, N_("KETMANEE"), N_("PATTACHOTE"),
-                                 N_("TIS820_2538"), N_("Manoonchai"));
+                                 N_("TIS820_2538"), N_("Manoonchai"),
+                                 N_("Custom"));
 FCITX_CONFIG_ENUM_NAME_WITH_I18N(thstrict_t, N_("Passthrough"),
                                  N_("Basic check"), N_("Strict"));
+FCITX_CONFIG_ENUM_NAME_WITH_I18N(ThaiCommitMode, N_("Immediate"),
+                                 N_("Cell"), N_("Word"));
 
 FCITX_CONFIGURATION(
     LibThaiConfig,
     OptionWithAnnotation<ThaiKBMap, ThaiKBMapI18NAnnotation> keyboardMap{
         this, "KeyboardMap", _("Keyboard Map"), ThaiKBMap::KETMANEE};
+    // Name of a file in libthai/layouts without the .kb suffix, compiled
+    // with libthai_layoutcompile.
+    Option<std::string> customLayout{this, "CustomLayout",
+                                     _("Custom Keyboard Layout"), ""};
     Option<bool> correction{this, "Correction", _("Correction"), true};
     OptionWithAnnotation<thstrict_t, thstrict_tI18NAnnotation> strictness{
         this, "Strictness", _("Strictness"), ISC_BASICCHECK};
+    OptionWithAnnotation<ThaiCommitMode, ThaiCommitModeI18NAnnotation>
+        commitMode{this, "CommitMode", _("Commit Mode"),
+                   ThaiCommitMode::Immediate};
+    Option<int, IntConstrain> wordCommitTimeout{
+        this, "WordCommitTimeout", _("Word Commit Timeout (ms)"), 1000,
+        IntConstrain(0, 10000)};
+    Option<bool> prediction{this, "Prediction", _("Word Prediction"), false};
+    Option<bool> spellCheck{this, "SpellCheck", _("Flag Unknown Words"),
+                            false};
+    KeyListOption pasteNormalizedKeys{this,
+                                      "PasteNormalized",
+                                      _("Paste Clipboard with Thai Normalized"),
+                                      {},
+                                      KeyListConstrain()};
 
 );
 
 class LibThaiState;
+class LibThaiStateHolder;
 
 class LibThaiEngine final : public InputMethodEngine {
 public:
@@ -55,23 +95,126 @@ public:
                InputContextEvent &event) override;
     void deactivate(const fcitx::InputMethodEntry & /*entry*/,
                     fcitx::InputContextEvent &event) override;
-    const fcitx::Configuration *getConfig() const override { return &config_; }
+    const fcitx::Configuration *getConfig() const override {
+        ensureConfigLoaded();
+        return &config_;
+    }
     void setConfig(const fcitx::RawConfig &raw) override {
+        ensureConfigLoaded();
         config_.load(raw, true);
-        safeSaveAsIni(config_, "conf/libthai.conf");
+        updateCoreConfig();
+        // Applied right away, the file is written in the background.
+        RawConfig snapshot;
+        config_.save(snapshot);
+        configWriter_.save(std::move(snapshot));
+    }
+
+    void reloadConfig() override {
+        // Do not read back a file that is about to be replaced.
+        configWriter_.flush();
+        readAsIni(config_, "conf/libthai.conf");
+        // The layout file may have been recompiled.
+        customLayoutName_.reset();
+        configLoaded_ = true;
+        updateCoreConfig();
+    }
+
+    Instance *instance() { return instance_; }
+    const LibThaiConfig &config() const {
+        ensureConfigLoaded();
+        return config_;
+    }
+    // Opened on first use, nullptr if iconv does not support TIS-620.
+    const IconvWrapper *convFromUtf8();
+    const IconvWrapper *convToUtf8();
+
+    LibThaiStats stats() { return stats_.snapshot(); }
+    LibThaiStats inputContextStats(InputContext *ic);
+    void resetStats();
+
+    // Number of characters at the end of text to keep in the preedit with the
+    // current commit mode.
+    size_t pendingLength(ThaiContextView text);
+
+    // Run a burst of keys through the keymap and validation against one
+    // evolving context, then send a single delete and commit. Returns the
+    // number of keys consumed, processing stops at the first key that has to
+    // reach the client itself, e.g. Return.
+    size_t processKeys(InputContext *ic, const std::vector<Key> &keys);
+
+    std::string normalizeText(const std::string &text) {
+        return ThaiNormalizeText(text);
     }
 
-    void reloadConfig() override { readAsIni(config_, "conf/libthai.conf"); }
+    // Commit the preedit and the rest of a predicted word.
+    void commitPrediction(InputContext *ic, std::string_view remainder);
 
-    auto &convFromUtf8() const { return convFromUtf8_; }
-    auto &convToUtf8() const { return convToUtf8_; }
+    void setTraceEnabled(bool enabled) { tracer_.setEnabled(enabled); }
+    bool flushTrace(const std::string &path) { return tracer_.flush(path); }
 
 private:
+    // The dictionary is only mapped once prediction or spell check is used.
+    const ThaiPredictionDict *predictionDict();
+    void updatePrediction(InputContext *ic, LibThaiState *state);
+    void clearPrediction(InputContext *ic);
+    // Flag the word completed by the last commit if it is not in the
+    // dictionary.
+    void checkSpelling(LibThaiState *state);
+
+    // Commit the normalized clipboard, returns false if it is not available.
+    bool pasteNormalized(InputContext *ic, LibThaiState *state);
+
+    // Nothing but the addon itself is set up when it is loaded, the rest is
+    // done on first activation.
+    void initialize();
+
+    // Allocate the state of ic if needed.
+    LibThaiState *state(InputContext *ic);
+    // nullptr if ic has no state.
+    LibThaiState *findState(InputContext *ic);
+    void releaseIdleStates();
+
+    void ensureConfigLoaded() const {
+        if (!configLoaded_) {
+            readAsIni(config_, "conf/libthai.conf");
+            configLoaded_ = true;
+        }
+    }
+
+    void updateCoreConfig();
+    // Map the configured custom layout if it changed, nullptr if it can not
+    // be loaded.
+    ThaiKeyTable customKeys();
+
     Instance *instance_;
-    IconvWrapper convFromUtf8_;
-    IconvWrapper convToUtf8_;
-    LibThaiConfig config_;
-    FactoryFor<LibThaiState> factory_;
+    std::unique_ptr<IconvWrapper> convFromUtf8_;
+    std::unique_ptr<IconvWrapper> convToUtf8_;
+    mutable LibThaiConfig config_;
+    mutable bool configLoaded_ = false;
+    ThaiConfigWriter configWriter_{"conf/libthai.conf"};
+    // Created by initialize(), holds the decision tables.
+    std::unique_ptr<ThaiEngineCore> core_;
+    FactoryFor<LibThaiStateHolder> factory_;
+    std::vector<std::unique_ptr<HandlerTableEntry<EventHandler>>>
+        eventWatchers_;
+    std::unique_ptr<EventSourceTime> idleTimer_;
+    ThaiStatsRecorder stats_;
+    ThaiTracer tracer_;
+    ThaiKBLayout customLayout_;
+    // Name of the layout in customLayout_, unset if it needs to be loaded.
+    std::optional<std::string> customLayoutName_;
+    ThaiPredictionDict predictionDict_;
+    bool predictionDictLoaded_ = false;
+
+    FCITX_ADDON_DEPENDENCY_LOADER(clipboard, instance_->addonManager());
+
+    FCITX_ADDON_EXPORT_FUNCTION(LibThaiEngine, stats);
+    FCITX_ADDON_EXPORT_FUNCTION(LibThaiEngine, inputContextStats);
+    FCITX_ADDON_EXPORT_FUNCTION(LibThaiEngine, resetStats);
+    FCITX_ADDON_EXPORT_FUNCTION(LibThaiEngine, setTraceEnabled);
+    FCITX_ADDON_EXPORT_FUNCTION(LibThaiEngine, flushTrace);
+    FCITX_ADDON_EXPORT_FUNCTION(LibThaiEngine, processKeys);
+    FCITX_ADDON_EXPORT_FUNCTION(LibThaiEngine, normalizeText);
 };
 
 class LibThaiFactory : public AddonFactory {
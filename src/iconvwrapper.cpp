@@ -6,59 +6,205 @@
  */
 
 #include "iconvwrapper.h"
+#include <algorithm>
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
-#include <fcitx-utils/utf8.h>
 #include <iconv.h>
-#include <iterator>
 #include <memory>
+#include <string>
 #include <string_view>
+#include <strings.h>
+#include <unordered_map>
 #include <vector>
 
+namespace {
+
+constexpr char SUBSTITUTE_CHAR = '?';
+
+// Length of the longest prefix of s that starts a well formed UTF-8
+// sequence, at least 1. This is the "maximal subpart" of the Unicode
+// standard: conversion resumes at the first byte that can not continue the
+// sequence, so a truncated or overlong sequence never swallows the valid
+// characters after it.
+size_t utf8MaximalSubpart(std::string_view s) {
+    const auto lead = static_cast<uint8_t>(s[0]);
+    size_t length;
+    // Allowed range of the second byte, the others are always 0x80..0xBF.
+    uint8_t low = 0x80;
+    uint8_t high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) {
+            low = 0xA0;
+        } else if (lead == 0xED) {
+            high = 0x9F;
+        }
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) {
+            low = 0x90;
+        } else if (lead == 0xF4) {
+            high = 0x8F;
+        }
+    } else {
+        return 1;
+    }
+    size_t i = 1;
+    for (; i < length && i < s.size(); i++) {
+        const auto c = static_cast<uint8_t>(s[i]);
+        if (c < low || c > high) {
+            break;
+        }
+        low = 0x80;
+        high = 0xBF;
+    }
+    return i;
+}
+
+} // namespace
+
+// iconv_t keeps a shift state and the output goes to a reused buffer, so
+// every thread converts with its own copy, opened the first time the thread
+// uses the encoding pair. Keying by the pair rather than by wrapper lets
+// wrappers come and go without leaving states behind, the few pairs in use
+// are closed when the thread exits.
+struct IconvThreadState {
+    IconvThreadState(const std::string &from, const std::string &to)
+        : conv(iconv_open(to.c_str(), from.c_str())) {}
+    ~IconvThreadState() {
+        if (conv != reinterpret_cast<iconv_t>(-1)) {
+            iconv_close(conv);
+        }
+    }
+
+    IconvThreadState(const IconvThreadState &) = delete;
+    IconvThreadState &operator=(const IconvThreadState &) = delete;
+
+    iconv_t conv;
+    std::string buffer;
+};
+
 class IconvWrapperPrivate {
 public:
-    IconvWrapperPrivate(iconv_t conv) : conv_(conv) {}
-    ~IconvWrapperPrivate() {
-        if (conv_ != reinterpret_cast<iconv_t>(-1)) {
-            iconv_close(conv_);
+    IconvWrapperPrivate(const char *from, const char *to)
+        : from_(from), to_(to), key_(from_ + '\n' + to_),
+          fromUtf8_(strcasecmp(from, "UTF-8") == 0) {
+        valid_ = state().conv != reinterpret_cast<iconv_t>(-1);
+    }
+
+    IconvThreadState &state() const {
+        thread_local std::unordered_map<std::string,
+                                        std::unique_ptr<IconvThreadState>>
+            states;
+        auto &state = states[key_];
+        if (!state) {
+            state = std::make_unique<IconvThreadState>(from_, to_);
+        }
+        return *state;
+    }
+
+    // Length of the invalid sequence at the start of s.
+    size_t invalidSequenceLength(std::string_view s) const {
+        if (!fromUtf8_) {
+            return 1;
         }
+        return utf8MaximalSubpart(s);
     }
-    iconv_t conv_;
+
+    const std::string from_;
+    const std::string to_;
+    const std::string key_;
+    const bool fromUtf8_;
+    bool valid_ = false;
 };
 
 IconvWrapper::IconvWrapper(const char *from, const char *to)
-    : d_ptr(std::make_unique<IconvWrapperPrivate>(iconv_open(to, from))) {}
+    : d_ptr(std::make_unique<IconvWrapperPrivate>(from, to)) {}
 
 IconvWrapper::~IconvWrapper() {}
 
-IconvWrapper::operator bool() const {
-    return d_ptr->conv_ != reinterpret_cast<iconv_t>(-1);
-}
+IconvWrapper::operator bool() const { return d_ptr->valid_; }
 
-std::vector<uint8_t> IconvWrapper::tryConvert(std::string_view s) const {
-    iconv_t conv = d_ptr->conv_;
-    for (auto iter = std::begin(s), e = std::end(s); iter != e;
-         iter = fcitx::utf8::nextChar(iter)) {
-        std::vector<uint8_t> result;
-        result.resize(s.size() * 10);
-        size_t byteLength = s.size();
-        size_t byteRemains = result.size();
-        char *data = const_cast<char *>(s.data());
-        char *outData = reinterpret_cast<char *>(result.data());
-        auto err = iconv(conv, &data, &byteLength, &outData, &byteRemains);
-        if (err == static_cast<size_t>(-1)) {
-            continue;
+IconvResult IconvWrapper::convert(std::string_view s,
+                                  IconvErrorPolicy policy) const {
+    auto *d = d_ptr.get();
+    IconvResult result;
+    if (!d->valid_) {
+        result.errorOffset = 0;
+        return result;
+    }
+    auto &state = d->state();
+    iconv_t conv = state.conv;
+    auto &buffer = state.buffer;
+    // Reset to the initial shift state.
+    iconv(conv, nullptr, nullptr, nullptr, nullptr);
+    // TIS-620 <-> UTF-8 never grows more than 3 times, so this normally
+    // avoids any resize after the buffer warmed up.
+    buffer.resize(std::max(buffer.capacity(), s.size() * 3 + 4));
+
+    char *in = const_cast<char *>(s.data());
+    size_t inLeft = s.size();
+    size_t used = 0;
+    auto ensureSpace = [&buffer, &used](size_t size) {
+        if (buffer.size() - used < size) {
+            buffer.resize(std::max(buffer.size() * 2, used + size));
         }
-        byteLength = 0;
-        err = iconv(conv, nullptr, &byteLength, &outData, &byteRemains);
-        if (err == static_cast<size_t>(-1)) {
+    };
+    auto finish = [&]() {
+        result.consumed = in - s.data();
+        result.output = std::string_view(buffer.data(), used);
+        return result;
+    };
+
+    while (inLeft) {
+        char *out = buffer.data() + used;
+        size_t outLeft = buffer.size() - used;
+        auto err = iconv(conv, &in, &inLeft, &out, &outLeft);
+        used = buffer.size() - outLeft;
+        if (err != static_cast<size_t>(-1)) {
             continue;
         }
-        if (data != s.data() + s.size()) {
+        if (errno == E2BIG) {
+            ensureSpace(buffer.size());
             continue;
         }
-        result.resize(result.size() - byteRemains);
-        return result;
+        // EILSEQ or EINVAL, in has not been advanced past the bad sequence.
+        const size_t offset = in - s.data();
+        if (result.ok()) {
+            result.errorOffset = offset;
+        }
+        if (policy == IconvErrorPolicy::Stop) {
+            return finish();
+        }
+        auto skip = d->invalidSequenceLength(s.substr(offset));
+        in += skip;
+        inLeft -= skip;
+        if (policy == IconvErrorPolicy::Substitute) {
+            ensureSpace(1);
+            buffer[used++] = SUBSTITUTE_CHAR;
+        }
+    }
+
+    for (;;) {
+        char *out = buffer.data() + used;
+        size_t outLeft = buffer.size() - used;
+        auto err = iconv(conv, nullptr, nullptr, &out, &outLeft);
+        used = buffer.size() - outLeft;
+        if (err != static_cast<size_t>(-1) || errno != E2BIG) {
+            break;
+        }
+        ensureSpace(buffer.size());
+    }
+    return finish();
+}
+
+std::vector<uint8_t> IconvWrapper::tryConvert(std::string_view s) const {
+    auto result = convert(s, IconvErrorPolicy::Stop);
+    if (!result.ok()) {
+        return {};
     }
-    return {};
+    return {result.output.begin(), result.output.end()};
 }
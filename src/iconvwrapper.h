@@ -7,6 +7,7 @@
 #ifndef _FCITX5_LIBTHAI_ICONWRAPPER_H_
 #define _FCITX5_LIBTHAI_ICONWRAPPER_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <fcitx-utils/macros.h>
 #include <memory>
@@ -15,6 +16,33 @@
 
 class IconvWrapperPrivate;
 
+enum class IconvErrorPolicy {
+    // Stop at the first sequence that can not be converted.
+    Stop,
+    // Drop sequences that can not be converted.
+    Skip,
+    // Replace sequences that can not be converted with '?'.
+    Substitute,
+};
+
+struct IconvResult {
+    // Converted bytes. Points into a buffer owned by the calling thread, and
+    // stays valid until the thread converts between the same encodings again.
+    std::string_view output;
+    // Number of input bytes consumed. Less than the input size only if the
+    // conversion stopped on an error, in which case it equals errorOffset and
+    // the conversion can be resumed from there.
+    size_t consumed = 0;
+    // Byte offset of the first sequence that could not be converted.
+    size_t errorOffset = std::string_view::npos;
+
+    bool ok() const { return errorOffset == std::string_view::npos; }
+};
+
+// Conversion through iconv for text the table codec in thaicodec.h does not
+// cover. The wrapper itself is immutable: each thread converts with its own
+// iconv_t, opened on its first conversion, so one wrapper may be shared by
+// any number of threads.
 class IconvWrapper {
 public:
     IconvWrapper(const char *from, const char *to);
@@ -23,6 +51,13 @@ public:
 
     operator bool() const;
 
+    // Convert s in a single pass. The output buffer belongs to the calling
+    // thread and is shared by every wrapper with the same encodings, see
+    // IconvResult::output.
+    IconvResult convert(std::string_view s,
+                        IconvErrorPolicy policy = IconvErrorPolicy::Stop) const;
+
+    // Returns an empty vector if any part of s can not be converted.
     std::vector<uint8_t> tryConvert(std::string_view s) const;
 
 private:
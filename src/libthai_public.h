@@ -0,0 +1,87 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_LIBTHAI_PUBLIC_H_
+#define _FCITX5_LIBTHAI_LIBTHAI_PUBLIC_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fcitx-utils/key.h>
+#include <fcitx/addoninstance.h>
+#include <fcitx/inputcontext.h>
+
+namespace fcitx {
+
+enum class LibThaiCounter {
+    // Key presses seen by the engine.
+    Keys,
+    // Keys not handled by the engine.
+    Passed,
+    // Keys that made the engine forget the text before the cursor.
+    ContextLost,
+    // Keys rejected as invalid input sequence.
+    Rejected,
+    // Keys that needed a correction the client can not apply.
+    Filtered,
+    // Keys that produced a commit.
+    Committed,
+    // Commits that needed to delete surrounding text first.
+    Corrections,
+    // Commits dropped because the conversion returned nothing.
+    CommitFailures,
+    Last = CommitFailures,
+};
+
+constexpr size_t LIBTHAI_COUNTERS =
+    static_cast<size_t>(LibThaiCounter::Last) + 1;
+
+// latency[0] counts key events that took less than 1us, latency[i] those that
+// took [2^(i-1), 2^i) us, the last bucket has everything slower.
+constexpr size_t LIBTHAI_LATENCY_BUCKETS = 16;
+
+struct LibThaiStats {
+    std::array<uint64_t, LIBTHAI_COUNTERS> counters{};
+    std::array<uint64_t, LIBTHAI_LATENCY_BUCKETS> latency{};
+
+    uint64_t counter(LibThaiCounter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+};
+
+} // namespace fcitx
+
+// Counters of the whole engine.
+FCITX_ADDON_DECLARE_FUNCTION(LibThaiEngine, stats, fcitx::LibThaiStats());
+// Counters of a single input context.
+FCITX_ADDON_DECLARE_FUNCTION(LibThaiEngine, inputContextStats,
+                             fcitx::LibThaiStats(fcitx::InputContext *));
+FCITX_ADDON_DECLARE_FUNCTION(LibThaiEngine, resetStats, void());
+
+// Record the phases of every key event in memory. Tracing can also be enabled
+// at startup by setting FCITX_LIBTHAI_TRACE in the environment.
+FCITX_ADDON_DECLARE_FUNCTION(LibThaiEngine, setTraceEnabled, void(bool));
+// Write the recorded key events to a Chrome trace event JSON file.
+FCITX_ADDON_DECLARE_FUNCTION(LibThaiEngine, flushTrace,
+                             bool(const std::string &));
+
+// Process a burst of keys, e.g. from remote input or a macro, and send the
+// result to the client as one delete and one commit. The key code selects the
+// character, the key symbol tells control keys apart. Returns the number of
+// keys consumed. Processing stops at the first key the input context has to
+// handle itself, the caller should forward it and pass the rest again.
+FCITX_ADDON_DECLARE_FUNCTION(LibThaiEngine, processKeys,
+                             size_t(fcitx::InputContext *,
+                                    const std::vector<fcitx::Key> &));
+
+// Reorder vowels and tone marks of the Thai text in a UTF-8 string and drop
+// duplicated ones, like libthai th_normalize. Other text is left untouched.
+FCITX_ADDON_DECLARE_FUNCTION(LibThaiEngine, normalizeText,
+                             std::string(const std::string &));
+
+#endif // _FCITX5_LIBTHAI_LIBTHAI_PUBLIC_H_
@@ -0,0 +1,91 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "mappedfile.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace fcitx {
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    data_ = static_cast<const uint8_t *>(data);
+    size_ = st.st_size;
+    return true;
+}
+
+bool MappedFile::replace(const std::string &path,
+                         const std::function<bool(std::ostream &)> &write) {
+    std::string tempPath = path + ".XXXXXX";
+    int fd = mkstemp(tempPath.data());
+    if (fd < 0) {
+        return false;
+    }
+    ::close(fd);
+    bool success;
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        success = out && write(out) && out.flush();
+    }
+    // mkstemp creates the file readable by the owner only.
+    success = success && chmod(tempPath.c_str(), 0644) == 0 &&
+              rename(tempPath.c_str(), path.c_str()) == 0;
+    if (!success) {
+        unlink(tempPath.c_str());
+    }
+    return success;
+}
+
+void MappedFile::close() {
+    if (data_) {
+        munmap(const_cast<uint8_t *>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+} // namespace fcitx
@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_MAPPEDFILE_H_
+#define _FCITX5_LIBTHAI_MAPPEDFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace fcitx {
+
+// Read only memory mapping of a whole file. Pages are only read from disk
+// when they are touched, and are shared between processes.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    // Returns false if the file can not be opened or is empty.
+    bool open(const std::string &path);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+
+    // Mappings of a file that is rewritten in place see it change, and a
+    // process that touches pages past a new end of file gets SIGBUS. So a
+    // file that may be mapped is always replaced: write fills a temporary
+    // file in the same directory, which is then renamed over path.
+    static bool replace(const std::string &path,
+                        const std::function<bool(std::ostream &)> &write);
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_MAPPEDFILE_H_
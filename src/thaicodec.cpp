@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "thaicodec.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace {
+
+// TIS-620 0xA1..0xDA and 0xDF..0xFB map to U+0E01..U+0E3A and
+// U+0E3F..U+0E5B, everything else above ASCII is unassigned.
+constexpr bool isTisThai(uint8_t c) {
+    return (c >= 0xA1 && c <= 0xDA) || (c >= 0xDF && c <= 0xFB);
+}
+
+// Offset of the code point inside the U+0E00 block is (c - 0xA0).
+constexpr uint32_t THAI_BLOCK_BASE = 0x0E00;
+constexpr uint8_t TIS_THAI_BASE = 0xA0;
+
+// UTF-8 encoding of U+0E00..U+0E7F is always three bytes:
+// 0xE0, 0xB8 | (offset >> 6), 0x80 | (offset & 0x3F).
+constexpr uint8_t UTF8_THAI_LEAD = 0xE0;
+constexpr uint8_t UTF8_THAI_SECOND_LOW = 0xB8;
+constexpr uint8_t UTF8_THAI_SECOND_HIGH = 0xB9;
+
+// Per trailing byte lookup for the two possible second bytes, 0 means the
+// sequence does not map to TIS-620.
+constexpr auto makeUtf8ToTisTable() {
+    std::array<std::array<uint8_t, 64>, 2> table{};
+    for (uint32_t c = 0x80; c <= 0xFF; c++) {
+        if (!isTisThai(c)) {
+            continue;
+        }
+        uint32_t offset = c - TIS_THAI_BASE;
+        table[offset >> 6][offset & 0x3F] = c;
+    }
+    return table;
+}
+
+constexpr auto utf8ToTisTable = makeUtf8ToTisTable();
+
+} // namespace
+
+size_t ThaiTisToUtf8(const uint8_t *in, size_t length, char *out,
+                     size_t outLength) {
+    size_t written = 0;
+    for (size_t i = 0; i < length; i++) {
+        const uint8_t c = in[i];
+        if (c < 0x80) {
+            if (written >= outLength) {
+                return THAI_CODEC_ERROR;
+            }
+            out[written++] = static_cast<char>(c);
+            continue;
+        }
+        if (!isTisThai(c) || outLength - written < TIS_UTF8_MAX_LENGTH) {
+            return THAI_CODEC_ERROR;
+        }
+        const uint32_t offset = THAI_BLOCK_BASE + c - TIS_THAI_BASE;
+        out[written++] = static_cast<char>(UTF8_THAI_LEAD);
+        out[written++] = static_cast<char>(0x80 | ((offset >> 6) & 0x3F));
+        out[written++] = static_cast<char>(0x80 | (offset & 0x3F));
+    }
+    return written;
+}
+
+size_t ThaiUtf8ToTis(std::string_view in, uint8_t *out, size_t outLength) {
+    size_t written = 0;
+    const auto *data = reinterpret_cast<const uint8_t *>(in.data());
+    const size_t length = in.size();
+    size_t i = 0;
+    while (i < length) {
+        if (written >= outLength) {
+            return THAI_CODEC_ERROR;
+        }
+        const uint8_t c = data[i];
+        if (c < 0x80) {
+            out[written++] = c;
+            i++;
+            continue;
+        }
+        if (c != UTF8_THAI_LEAD || length - i < 3) {
+            return THAI_CODEC_ERROR;
+        }
+        const uint8_t second = data[i + 1];
+        const uint8_t third = data[i + 2];
+        if ((second != UTF8_THAI_SECOND_LOW &&
+             second != UTF8_THAI_SECOND_HIGH) ||
+            (third & 0xC0) != 0x80) {
+            return THAI_CODEC_ERROR;
+        }
+        const uint8_t tis =
+            utf8ToTisTable[second - UTF8_THAI_SECOND_LOW][third & 0x3F];
+        if (!tis) {
+            return THAI_CODEC_ERROR;
+        }
+        out[written++] = tis;
+        i += 3;
+    }
+    return written;
+}
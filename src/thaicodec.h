@@ -0,0 +1,30 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_THAICODEC_H_
+#define _FCITX5_LIBTHAI_THAICODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// TIS-620 is ASCII plus the contiguous U+0E01..U+0E5B block, so conversion
+// is a table lookup and never needs iconv. Both functions write into caller
+// provided storage and return the number of bytes written, or
+// THAI_CODEC_ERROR if the input is not representable or out is too small.
+// There is no state at all, so both are safe to call from any thread.
+
+constexpr size_t THAI_CODEC_ERROR = static_cast<size_t>(-1);
+
+// Maximum number of UTF-8 bytes produced for a single TIS-620 byte.
+constexpr size_t TIS_UTF8_MAX_LENGTH = 3;
+
+size_t ThaiTisToUtf8(const uint8_t *in, size_t length, char *out,
+                     size_t outLength);
+
+size_t ThaiUtf8ToTis(std::string_view in, uint8_t *out, size_t outLength);
+
+#endif // _FCITX5_LIBTHAI_THAICODEC_H_
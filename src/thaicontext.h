@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_THAICONTEXT_H_
+#define _FCITX5_LIBTHAI_THAICONTEXT_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thai/thailib.h>
+
+namespace fcitx {
+
+// Non owning view of TIS-620 characters before the cursor.
+struct ThaiContextView {
+    const thchar_t *data = nullptr;
+    size_t size = 0;
+
+    bool empty() const { return size == 0; }
+    thchar_t back() const { return data[size - 1]; }
+
+    bool endsWith(ThaiContextView other) const {
+        return other.size <= size &&
+               std::equal(other.data, other.data + other.size,
+                          data + size - other.size);
+    }
+};
+
+// Fixed capacity window over the last N characters, stored inline so that
+// updating it never allocates. N is tiny, so shifting on overflow is cheaper
+// than ring arithmetic, and it keeps the characters contiguous for
+// th_prev_cell.
+template <size_t N>
+class ThaiHistory {
+    static_assert(N > 0 && N <= UINT8_MAX, "Invalid history size");
+
+public:
+    ThaiContextView view() const { return {chars_.data(), size_}; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    void clear() { size_ = 0; }
+
+    void append(const thchar_t *chr, size_t length) {
+        if (length >= N) {
+            std::memcpy(chars_.data(), chr + length - N, N);
+            size_ = N;
+            return;
+        }
+        if (size_ + length > N) {
+            const size_t drop = size_ + length - N;
+            std::memmove(chars_.data(), chars_.data() + drop, size_ - drop);
+            size_ -= drop;
+        }
+        std::memcpy(chars_.data() + size_, chr, length);
+        size_ += length;
+    }
+
+    void assign(const thchar_t *chr, size_t length) {
+        clear();
+        append(chr, length);
+    }
+
+    void dropBack(size_t length) {
+        size_ -= std::min<size_t>(length, size_);
+    }
+
+private:
+    std::array<thchar_t, N> chars_{};
+    uint8_t size_ = 0;
+};
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_THAICONTEXT_H_
@@ -0,0 +1,343 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "thaicore.h"
+#include "thaicontext.h"
+#include "thaikb.h"
+#include "thaitrace.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <fcitx-utils/key.h>
+#include <fcitx-utils/keysym.h>
+#include <thai/thailib.h>
+#include <thai/thbrk.h>
+#include <thai/thcell.h>
+#include <thai/thctype.h>
+#include <thai/thinp.h>
+
+namespace fcitx {
+
+namespace {
+
+// Word breaking is only run over the preedit, which is short.
+constexpr size_t MAX_WORD_BREAK_LENGTH = 64;
+
+// One bit for each keysym in a 0xXX00 page.
+using KeySymPage = std::array<uint64_t, 4>;
+
+constexpr void setKeySyms(KeySymPage &page, KeySym first, KeySym last) {
+    for (uint32_t sym = first; sym <= last; sym++) {
+        page[(sym & 0xFF) / 64] |= uint64_t(1) << (sym & 0x3F);
+    }
+}
+
+constexpr void setKeySym(KeySymPage &page, KeySym sym) {
+    setKeySyms(page, sym, sym);
+}
+
+constexpr bool testKeySym(const KeySymPage &page, uint32_t sym) {
+    return (page[(sym & 0xFF) / 64] >> (sym & 0x3F)) & 1;
+}
+
+constexpr KeySymPage makeContextLostKeys() {
+    KeySymPage page{};
+    for (auto sym : {FcitxKey_BackSpace, FcitxKey_Tab, FcitxKey_Linefeed,
+                     FcitxKey_Clear, FcitxKey_Return, FcitxKey_Pause,
+                     FcitxKey_Scroll_Lock, FcitxKey_Sys_Req, FcitxKey_Escape,
+                     FcitxKey_Delete}) {
+        setKeySym(page, sym);
+    }
+    // IsCursorkey
+    setKeySyms(page, FcitxKey_Home, FcitxKey_Begin);
+    // IsKeypadKey, non-chars only
+    setKeySyms(page, FcitxKey_KP_Space, FcitxKey_KP_Delete);
+    // IsMiscFunctionKey
+    setKeySyms(page, FcitxKey_Select, FcitxKey_Break);
+    // IsFunctionKey
+    setKeySyms(page, FcitxKey_F1, FcitxKey_F35);
+    return page;
+}
+
+constexpr KeySymPage makeContextIntactKeys() {
+    KeySymPage page{};
+    // Same as Key::isModifier.
+    for (auto sym : {FcitxKey_Control_L, FcitxKey_Control_R, FcitxKey_Meta_L,
+                     FcitxKey_Meta_R, FcitxKey_Alt_L, FcitxKey_Alt_R,
+                     FcitxKey_Super_L, FcitxKey_Super_R, FcitxKey_Hyper_L,
+                     FcitxKey_Hyper_R, FcitxKey_Shift_L, FcitxKey_Shift_R,
+                     FcitxKey_Mode_switch, FcitxKey_Num_Lock}) {
+        setKeySym(page, sym);
+    }
+    return page;
+}
+
+constexpr KeySymPage makeContextIntactIsoKeys() {
+    KeySymPage page{};
+    setKeySyms(page, FcitxKey_ISO_Lock, FcitxKey_ISO_Last_Group_Lock);
+    return page;
+}
+
+// Keys in the 0xFF00 page, and the ISO lock keys in the 0xFE00 page.
+constexpr KeySymPage contextLostKeys = makeContextLostKeys();
+constexpr KeySymPage contextIntactKeys = makeContextIntactKeys();
+constexpr KeySymPage contextIntactIsoKeys = makeContextIntactIsoKeys();
+
+static_assert(testKeySym(contextLostKeys, FcitxKey_F35) &&
+                  !testKeySym(contextLostKeys, FcitxKey_Shift_L),
+              "Context lost keys are wrong");
+static_assert(testKeySym(contextIntactKeys, FcitxKey_Shift_L) &&
+                  !testKeySym(contextIntactKeys, FcitxKey_F35),
+              "Context intact keys are wrong");
+
+int keyShiftLevel(KeyStates states) {
+    // Calculate shift level based on shift and mod5.
+    if (!states.testAny(KeyStates({KeyState::Shift, KeyState::Mod5}))) {
+        return 0;
+    }
+    return states.test(KeyState::Mod5) ? 2 : 1;
+}
+
+// Keypad digits are not part of the keyboard maps.
+thchar_t keypadChar(const ThaiKeyDescriptor &key, int shiftLevel) {
+    if ((FcitxKey_KP_0 <= key.sym) && (key.sym <= FcitxKey_KP_9) &&
+        key.states.test(KeyState::NumLock) &&
+        ((2 == shiftLevel) || (key.states.test(KeyState::CapsLock)))) {
+        return key.sym - FcitxKey_KP_0 + 0xf0;
+    }
+    return 0;
+}
+
+} // namespace
+
+void ThaiEngineCore::setConfig(const ThaiCoreConfig &config) {
+    config_ = config;
+    keyHandler_ = keyHandler(config);
+    decisions_.setStrictness(config.strictness);
+}
+
+bool ThaiEngineCore::isContextIntactKey(const ThaiKeyDescriptor &key) {
+    const uint32_t page = key.sym >> 8;
+    if (page == 0xFF) {
+        return testKeySym(contextIntactKeys, key.sym);
+    }
+    return page == 0xFE && testKeySym(contextIntactIsoKeys, key.sym);
+}
+
+bool ThaiEngineCore::isContextLostKey(const ThaiKeyDescriptor &key) {
+    return (key.sym >> 8) == 0xFF && testKeySym(contextLostKeys, key.sym);
+}
+
+thchar_t ThaiEngineCore::keyToChar(const ThaiKeyDescriptor &key) const {
+    const int shiftLevel = keyShiftLevel(key.states);
+    if (auto chr = keypadChar(key, shiftLevel)) {
+        return chr;
+    }
+    // Make sure we remove evdev offset 8 from the key code.
+    if (config_.keyboardMap == ThaiKBMap::Custom) {
+        return config_.customKeys
+                   ? ThaiKeycodeToChar(config_.customKeys, key.code - 8,
+                                       shiftLevel)
+                   : ThaiKeycodeToChar(ThaiKBMap::KETMANEE, key.code - 8,
+                                       shiftLevel);
+    }
+    return ThaiKeycodeToChar(config_.keyboardMap, key.code - 8, shiftLevel);
+}
+
+ThaiEngineCore::KeyHandler
+ThaiEngineCore::keyHandler(const ThaiCoreConfig &config) {
+    // Strictness is not part of the key, it only changes the data in
+    // ThaiDecisionTable.
+    static constexpr KeyHandler handlers[][5] = {
+        {&ThaiEngineCore::processKeyFor<false, ThaiKBMap::KETMANEE>,
+         &ThaiEngineCore::processKeyFor<false, ThaiKBMap::PATTACHOTE>,
+         &ThaiEngineCore::processKeyFor<false, ThaiKBMap::TIS820_2538>,
+         &ThaiEngineCore::processKeyFor<false, ThaiKBMap::MANOONCHAI>,
+         &ThaiEngineCore::processKeyFor<false, ThaiKBMap::Custom>},
+        {&ThaiEngineCore::processKeyFor<true, ThaiKBMap::KETMANEE>,
+         &ThaiEngineCore::processKeyFor<true, ThaiKBMap::PATTACHOTE>,
+         &ThaiEngineCore::processKeyFor<true, ThaiKBMap::TIS820_2538>,
+         &ThaiEngineCore::processKeyFor<true, ThaiKBMap::MANOONCHAI>,
+         &ThaiEngineCore::processKeyFor<true, ThaiKBMap::Custom>},
+    };
+    static_assert(std::size(handlers[0]) ==
+                      static_cast<size_t>(ThaiKBMap::Custom) + 1,
+                  "Missing key handler");
+    auto map = std::min(config.keyboardMap, ThaiKBMap::Custom);
+    if (map == ThaiKBMap::Custom && !config.customKeys) {
+        map = ThaiKBMap::KETMANEE;
+    }
+    return handlers[config.correction][static_cast<size_t>(map)];
+}
+
+template <bool correction, ThaiKBMap map>
+ThaiAction ThaiEngineCore::processKeyFor(const ThaiKeyDescriptor &key,
+                                         ThaiContextView context,
+                                         bool canDelete) {
+    ThaiAction action;
+    // If any ctrl alt super modifier is pressed, ignore.
+    if (key.states.testAny(KeyStates{KeyState::Ctrl_Alt, KeyState::Super}) ||
+        isContextLostKey(key)) {
+        action.type = ThaiActionType::ForgetContext;
+        return action;
+    }
+    if (key.sym == FcitxKey_None || isContextIntactKey(key)) {
+        return action;
+    }
+    thchar_t newChar;
+    {
+        ThaiTraceSpan span(tracer_, ThaiTracePhase::Keymap);
+        const int shiftLevel = keyShiftLevel(key.states);
+        newChar = keypadChar(key, shiftLevel);
+        if (!newChar) {
+            // Make sure we remove evdev offset 8 from the key code.
+            if constexpr (map == ThaiKBMap::Custom) {
+                newChar = ThaiKeycodeToChar(config_.customKeys, key.code - 8,
+                                            shiftLevel);
+            } else {
+                newChar = ThaiKeycodeToChar<map>(key.code - 8, shiftLevel);
+            }
+        }
+    }
+    if (0 == newChar) {
+        return action;
+    }
+    return processCharFor<correction>(newChar, context, canDelete);
+}
+
+ThaiAction ThaiEngineCore::processChar(thchar_t newChar,
+                                       ThaiContextView context,
+                                       bool canDelete) {
+    if (config_.correction) {
+        return processCharFor<true>(newChar, context, canDelete);
+    }
+    return processCharFor<false>(newChar, context, canDelete);
+}
+
+template <bool correction>
+ThaiAction ThaiEngineCore::processCharFor(thchar_t newChar,
+                                          ThaiContextView context,
+                                          bool canDelete) {
+    ThaiAction action;
+    // No correction -> just reject or commit
+    if constexpr (!correction) {
+        ThaiTraceSpan span(tracer_, ThaiTracePhase::Validate);
+        const thchar_t prevChar = context.empty() ? 0 : context.back();
+        if (!decisions_.isAccept(prevChar, newChar)) {
+            action.type = ThaiActionType::Reject;
+            return action;
+        }
+        action.type = ThaiActionType::Commit;
+        action.commit[0] = newChar;
+        action.length = 1;
+        return action;
+    }
+
+    thcell_t contextCell;
+    th_init_cell(&contextCell);
+    if (!context.empty()) {
+        ThaiTraceSpan span(tracer_, ThaiTracePhase::PrevCell);
+        th_prev_cell(context.data, context.size, &contextCell, true);
+    }
+    ThaiDecision decision;
+    {
+        ThaiTraceSpan span(tracer_, ThaiTracePhase::Validate);
+        decision = decisions_.validate(contextCell, newChar);
+    }
+    if (!decision.accept) {
+        action.type = ThaiActionType::Reject;
+        return action;
+    }
+    if (decision.offset < 0 && !canDelete) {
+        action.type = ThaiActionType::Filter;
+        return action;
+    }
+    action.type = ThaiActionType::Commit;
+    action.deleteCount = -decision.offset;
+    action.length = decision.length;
+    std::memcpy(action.commit, decision.conv, decision.length);
+    return action;
+}
+
+size_t ThaiEngineCore::pendingCellLength(ThaiContextView text) {
+    if (text.empty()) {
+        return 0;
+    }
+    thcell_t cell;
+    th_init_cell(&cell);
+    const size_t length = th_prev_cell(text.data, text.size, &cell, true);
+    // Only a consonant can take more above or below vowels and tone marks.
+    if (!th_isthcons(cell.base)) {
+        return 0;
+    }
+    return length;
+}
+
+int ThaiEngineCore::findWordBreaks(ThaiContextView text, int *breaks) {
+    if (!wordBreakerLoaded_) {
+        wordBreakerLoaded_ = true;
+        wordBreaker_.reset(th_brk_new(nullptr));
+    }
+    if (!wordBreaker_ || text.size > MAX_WORD_BREAK_LENGTH) {
+        return -1;
+    }
+    // th_brk_find_breaks needs a NUL terminated string.
+    thchar_t str[MAX_WORD_BREAK_LENGTH + 1];
+    std::memcpy(str, text.data, text.size);
+    str[text.size] = 0;
+    int numBreaks = th_brk_find_breaks(wordBreaker_.get(), str, breaks,
+                                       MAX_WORD_BREAK_LENGTH);
+    // Only keep the boundaries inside the text.
+    while (numBreaks > 0 &&
+           static_cast<size_t>(breaks[numBreaks - 1]) >= text.size) {
+        numBreaks--;
+    }
+    return std::max(numBreaks, 0);
+}
+
+size_t ThaiEngineCore::pendingWordLength(ThaiContextView text) {
+    if (text.empty()) {
+        return 0;
+    }
+    // Anything that is not Thai ends the word, e.g. space or punctuation.
+    if (!th_isthai(text.back())) {
+        return 0;
+    }
+    int breaks[MAX_WORD_BREAK_LENGTH];
+    const int numBreaks = findWordBreaks(text, breaks);
+    if (numBreaks < 0) {
+        return pendingCellLength(text);
+    }
+    return text.size - (numBreaks ? breaks[numBreaks - 1] : 0);
+}
+
+ThaiWordRange ThaiEngineCore::lastCompleteWord(ThaiContextView text) {
+    size_t end = text.size;
+    while (end > 0 && !th_isthai(text.data[end - 1])) {
+        end--;
+    }
+    if (end == 0) {
+        return {};
+    }
+    int breaks[MAX_WORD_BREAK_LENGTH];
+    int numBreaks = findWordBreaks({text.data, end}, breaks);
+    if (numBreaks < 0) {
+        return {};
+    }
+    // Without a trailing separator, the last word may still be typed.
+    if (end == text.size) {
+        if (numBreaks == 0) {
+            return {};
+        }
+        end = breaks[--numBreaks];
+    }
+    return {numBreaks ? static_cast<size_t>(breaks[numBreaks - 1]) : 0, end};
+}
+
+} // namespace fcitx
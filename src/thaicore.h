@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_THAICORE_H_
+#define _FCITX5_LIBTHAI_THAICORE_H_
+
+#include "thaicontext.h"
+#include "thaidecision.h"
+#include "thaikb.h"
+#include "thaitrace.h"
+#include <cstddef>
+#include <cstdint>
+#include <fcitx-utils/key.h>
+#include <fcitx-utils/keysym.h>
+#include <memory>
+#include <thai/thailib.h>
+#include <thai/thbrk.h>
+#include <thai/thinp.h>
+
+namespace fcitx {
+
+// The decision logic of the libthai input method, without any dependency on
+// fcitx InputContext or KeyEvent, so it can be driven by any frontend, a
+// benchmark or a fuzzer.
+
+enum class ThaiCommitMode {
+    // Commit every accepted key right away.
+    Immediate,
+    // Keep the cell being typed in the preedit, and commit it once the next
+    // cell starts.
+    Cell,
+    // Keep the word being typed in the preedit, and commit it once libthai
+    // word breaking finds the start of the next word.
+    Word,
+};
+
+struct ThaiCoreConfig {
+    ThaiKBMap keyboardMap = ThaiKBMap::KETMANEE;
+    bool correction = true;
+    thstrict_t strictness = ISC_BASICCHECK;
+    ThaiCommitMode commitMode = ThaiCommitMode::Immediate;
+    // Used when keyboardMap is Custom, KETMANEE is used if it is nullptr. The
+    // table must stay valid until the next setConfig.
+    ThaiKeyTable customKeys = nullptr;
+};
+
+// A key press, code is the evdev key code including the offset 8.
+struct ThaiKeyDescriptor {
+    KeySym sym = FcitxKey_None;
+    KeyStates states;
+    int code = 0;
+};
+
+enum class ThaiActionType {
+    // The key is not handled by the input method.
+    Pass,
+    // The key is not handled, and the text before the cursor may change.
+    ForgetContext,
+    // The key is an invalid input sequence and should be swallowed.
+    Reject,
+    // The key needs a correction that can not be applied, stop processing it
+    // but do not accept it.
+    Filter,
+    // Delete deleteCount characters before the cursor, then commit.
+    Commit,
+};
+
+struct ThaiAction {
+    ThaiActionType type = ThaiActionType::Pass;
+    unsigned int deleteCount = 0;
+    uint8_t length = 0;
+    thchar_t commit[4] = {0, 0, 0, 0};
+};
+
+// Half open range of characters.
+struct ThaiWordRange {
+    size_t begin = 0;
+    size_t end = 0;
+
+    bool empty() const { return begin == end; }
+    size_t size() const { return end - begin; }
+};
+
+class ThaiEngineCore {
+public:
+    ThaiEngineCore() = default;
+
+    void setConfig(const ThaiCoreConfig &config);
+    const ThaiCoreConfig &config() const { return config_; }
+
+    // Optional, records the phases of processKey.
+    void setTracer(ThaiTracer *tracer) { tracer_ = tracer; }
+
+    // Translate the key to a TIS-620 character with the configured keyboard
+    // map. Returns 0 if the key does not produce a character.
+    thchar_t keyToChar(const ThaiKeyDescriptor &key) const;
+
+    // context is the text before the cursor, canDelete tells whether the
+    // frontend is able to delete it.
+    ThaiAction processKey(const ThaiKeyDescriptor &key, ThaiContextView context,
+                          bool canDelete) {
+        return (this->*keyHandler_)(key, context, canDelete);
+    }
+    ThaiAction processChar(thchar_t newChar, ThaiContextView context,
+                           bool canDelete);
+
+    // Number of characters at the end of text that form a cell which may
+    // still take more vowels or tone marks, 0 if the text can be committed as
+    // a whole.
+    static size_t pendingCellLength(ThaiContextView text);
+    // Number of characters at the end of text after the last word boundary.
+    // The word break dictionary is loaded on first use.
+    size_t pendingWordLength(ThaiContextView text);
+    // The last word in text that is followed by a word boundary, either a non
+    // Thai character or the start of another word. Empty if there is none.
+    ThaiWordRange lastCompleteWord(ThaiContextView text);
+
+    static bool isContextLostKey(const ThaiKeyDescriptor &key);
+    static bool isContextIntactKey(const ThaiKeyDescriptor &key);
+
+private:
+    using KeyHandler = ThaiAction (ThaiEngineCore::*)(const ThaiKeyDescriptor &,
+                                                      ThaiContextView, bool);
+
+    // processKey specialized for one configuration, selected by setConfig so
+    // that a key press does not branch on it.
+    template <bool correction, ThaiKBMap map>
+    ThaiAction processKeyFor(const ThaiKeyDescriptor &key,
+                             ThaiContextView context, bool canDelete);
+    template <bool correction>
+    ThaiAction processCharFor(thchar_t newChar, ThaiContextView context,
+                              bool canDelete);
+    static KeyHandler keyHandler(const ThaiCoreConfig &config);
+
+    // Boundaries inside text in ascending order, returns -1 if word breaking
+    // is not available.
+    int findWordBreaks(ThaiContextView text, int *breaks);
+
+    ThaiCoreConfig config_;
+    KeyHandler keyHandler_ = keyHandler(config_);
+    ThaiDecisionTable decisions_;
+    ThaiTracer *tracer_ = nullptr;
+
+    struct ThBrkDeleter {
+        void operator()(ThBrk *brk) const { th_brk_delete(brk); }
+    };
+    std::unique_ptr<ThBrk, ThBrkDeleter> wordBreaker_;
+    bool wordBreakerLoaded_ = false;
+};
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_THAICORE_H_
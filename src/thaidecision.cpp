@@ -0,0 +1,93 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "thaidecision.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thai/thailib.h>
+#include <thai/thcell.h>
+#include <thai/thinp.h>
+
+namespace fcitx {
+
+namespace {
+
+ThaiDecisionTable &threadDecisionTable(thstrict_t strictness) {
+    thread_local std::array<std::unique_ptr<ThaiDecisionTable>,
+                            ISC_STRICT + 1>
+        tables;
+    auto &table = tables[strictness];
+    if (!table) {
+        table = std::make_unique<ThaiDecisionTable>(strictness);
+    }
+    return *table;
+}
+
+} // namespace
+
+ThaiDecisionTable::ThaiDecisionTable(thstrict_t strictness)
+    : strictness_(strictness) {
+    rebuild();
+}
+
+void ThaiDecisionTable::setStrictness(thstrict_t strictness) {
+    if (strictness_ == strictness) {
+        return;
+    }
+    strictness_ = strictness;
+    rebuild();
+}
+
+void ThaiDecisionTable::rebuild() {
+    accept_.fill(0);
+    for (size_t prev = 0; prev < 256; prev++) {
+        for (size_t c = 0; c < 256; c++) {
+            if (th_isaccept(prev, c, strictness_)) {
+                const size_t index = (prev << 8) | c;
+                accept_[index / 64] |= uint64_t(1) << (index % 64);
+            }
+        }
+    }
+    memo_.fill(MemoEntry());
+}
+
+ThaiDecision ThaiDecisionTable::validate(const thcell_t &context, thchar_t c) {
+    // c is never 0 for a real key, so a valid key is never 0 either.
+    const uint32_t key = (static_cast<uint32_t>(context.base) << 24) |
+                         (static_cast<uint32_t>(context.hilo) << 16) |
+                         (static_cast<uint32_t>(context.top) << 8) | c;
+    auto &entry = memo_[(key * 2654435761U) >> (32 - MEMO_BITS)];
+    if (key != 0 && entry.key == key) {
+        return entry.decision;
+    }
+
+    thinpconv_t conv;
+    ThaiDecision decision;
+    decision.accept = th_validate_leveled(context, c, &conv, strictness_);
+    if (decision.accept) {
+        decision.offset = conv.offset;
+        decision.length = strnlen(reinterpret_cast<const char *>(conv.conv),
+                                  sizeof(conv.conv));
+        std::memcpy(decision.conv, conv.conv, decision.length);
+    }
+    entry.key = key;
+    entry.decision = decision;
+    return decision;
+}
+
+bool ThaiIsAccept(thchar_t prev, thchar_t c, thstrict_t strictness) {
+    return threadDecisionTable(strictness).isAccept(prev, c);
+}
+
+ThaiDecision ThaiValidate(const thcell_t &context, thchar_t c,
+                          thstrict_t strictness) {
+    return threadDecisionTable(strictness).validate(context, c);
+}
+
+} // namespace fcitx
@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_THAIDECISION_H_
+#define _FCITX5_LIBTHAI_THAIDECISION_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <thai/thailib.h>
+#include <thai/thcell.h>
+#include <thai/thinp.h>
+
+namespace fcitx {
+
+// Result of th_validate_leveled.
+struct ThaiDecision {
+    bool accept = false;
+    // Number of characters before the cursor to replace, zero or negative.
+    int8_t offset = 0;
+    uint8_t length = 0;
+    thchar_t conv[4] = {0, 0, 0, 0};
+};
+
+// Caches the libthai input sequence check for one strictness level.
+// th_isaccept only depends on the two characters, so it is expanded into a
+// bitmap when the level is set. th_validate_leveled depends on the whole
+// previous cell, so its results are memoized in a small direct mapped table.
+// validate updates the memo, so a table must not be shared between threads,
+// use ThaiValidate below instead.
+class ThaiDecisionTable {
+public:
+    explicit ThaiDecisionTable(thstrict_t strictness = ISC_BASICCHECK);
+
+    // Rebuild the tables if strictness changes.
+    void setStrictness(thstrict_t strictness);
+    thstrict_t strictness() const { return strictness_; }
+
+    bool isAccept(thchar_t prev, thchar_t c) const {
+        const size_t index = (static_cast<size_t>(prev) << 8) | c;
+        return (accept_[index / 64] >> (index % 64)) & 1;
+    }
+
+    ThaiDecision validate(const thcell_t &context, thchar_t c);
+
+private:
+    static constexpr size_t MEMO_BITS = 10;
+
+    struct MemoEntry {
+        // Packed cell and new character, 0 if the entry is unused.
+        uint32_t key = 0;
+        ThaiDecision decision;
+    };
+
+    void rebuild();
+
+    thstrict_t strictness_;
+    std::array<uint64_t, 256 * 256 / 64> accept_{};
+    std::array<MemoEntry, 1 << MEMO_BITS> memo_{};
+};
+
+// Same checks as ThaiDecisionTable, safe to call from any thread. Each thread
+// builds its own table for a strictness level the first time it checks at
+// that level.
+bool ThaiIsAccept(thchar_t prev, thchar_t c, thstrict_t strictness);
+ThaiDecision ThaiValidate(const thcell_t &context, thchar_t c,
+                          thstrict_t strictness);
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_THAIDECISION_H_
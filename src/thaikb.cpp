@@ -8,1103 +8,289 @@
 #include "thaikb.h"
 
 #include <fcitx-utils/macros.h>
-#include <thai/tis.h>
 
 namespace {
 
-constexpr int N_KEYCODES = 54;
-constexpr int N_LEVELS = 3;
+constexpr int N_KEYCODES = THAI_KB_KEYCODES;
+constexpr int N_LEVELS = THAI_KB_LEVELS;
+constexpr int N_MAPS = static_cast<int>(ThaiKBMap::Last) + 1;
 
-constexpr unsigned char tis_keycode_map[N_KEYCODES][N_LEVELS] = {
-    /* 0x00 */
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_YMBOL_BAHT,
-        TIS_LAKKHANGYAO,
-        TIS_LAKKHANGYAO,
-    },
-    {
-        '/',
-        TIS_THAI_DIGIT_ONE,
-        TIS_THAI_DIGIT_ONE,
-    },
-    {
-        '-',
-        TIS_THAI_DIGIT_TWO,
-        TIS_THAI_DIGIT_TWO,
-    },
-    {
-        TIS_PHO_SAMPHAO,
-        TIS_THAI_DIGIT_THREE,
-        TIS_THAI_DIGIT_THREE,
-    },
-    {
-        TIS_THO_THUNG,
-        TIS_THAI_DIGIT_FOUR,
-        TIS_THAI_DIGIT_FOUR,
-    },
-    {
-        TIS_SARA_U,
-        TIS_SARA_UU,
-        TIS_SARA_UU,
-    },
-    {
-        TIS_SARA_UE,
-        TIS_YAMAKKAN,
-        TIS_YAMAKKAN,
-    },
-    {
-        TIS_KHO_KHWAI,
-        TIS_THAI_DIGIT_FIVE,
-        TIS_THAI_DIGIT_FIVE,
-    },
-    {
-        TIS_TO_TAO,
-        TIS_THAI_DIGIT_SIX,
-        TIS_THAI_DIGIT_SIX,
-    },
-    {
-        TIS_CHO_CHAN,
-        TIS_THAI_DIGIT_SEVEN,
-        TIS_THAI_DIGIT_SEVEN,
-    },
-    {
-        TIS_KHO_KHAI,
-        TIS_THAI_DIGIT_EIGHT,
-        TIS_THAI_DIGIT_EIGHT,
-    },
-    {
-        TIS_CHO_CHANG,
-        TIS_THAI_DIGIT_NINE,
-        TIS_THAI_DIGIT_NINE,
-    },
-    {
-        0x08,
-        0x08,
-        0x08,
-    },
-    {
-        0x09,
-        0x09,
-        0x09,
-    },
-    /* 0x10 */
-    {
-        TIS_MAIYAMOK,
-        TIS_THAI_DIGIT_ZERO,
-        TIS_THAI_DIGIT_ZERO,
-    },
-    {
-        TIS_SARA_AI_MAIMALAI,
-        '"',
-        '"',
-    },
-    {
-        TIS_SARA_AM,
-        TIS_DO_CHADA,
-        TIS_DO_CHADA,
-    },
-    {
-        TIS_PHO_PHAN,
-        TIS_THO_NANGMONTHO,
-        TIS_THO_NANGMONTHO,
-    },
-    {
-        TIS_SARA_A,
-        TIS_THO_THONG,
-        TIS_THO_THONG,
-    },
-    {
-        TIS_MAI_HAN_AKAT,
-        TIS_NIKHAHIT,
-        TIS_NIKHAHIT,
-    },
-    {
-        TIS_SARA_II,
-        TIS_MAI_TRI,
-        TIS_MAI_TRI,
-    },
-    {
-        TIS_RO_RUA,
-        TIS_NO_NEN,
-        TIS_NO_NEN,
-    },
-    {
-        TIS_NO_NU,
-        TIS_PAIYANNOI,
-        TIS_ANGKHANKHU,
-    },
-    {
-        TIS_YO_YAK,
-        TIS_YO_YING,
-        TIS_YO_YING,
-    },
-    {
-        TIS_BO_BAIMAI,
-        TIS_THO_THAN,
-        TIS_THO_THAN,
-    },
-    {
-        TIS_LO_LING,
-        ',',
-        ',',
-    },
-    {
-        0x0d,
-        0x0d,
-        0x0d,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_FO_FAN,
-        TIS_RU,
-        TIS_RU,
-    },
-    {
-        TIS_HO_HIP,
-        TIS_KHO_RAKHANG,
-        TIS_KHO_RAKHANG,
-    },
-    /* 0x20 */
-    {
-        TIS_KO_KAI,
-        TIS_TO_PATAK,
-        TIS_TO_PATAK,
-    },
-    {
-        TIS_DO_DEK,
-        TIS_SARA_O,
-        TIS_SARA_O,
-    },
-    {
-        TIS_SARA_E,
-        TIS_CHO_CHOE,
-        TIS_CHO_CHOE,
-    },
-    {
-        TIS_MAI_THO,
-        TIS_MAITAIKHU,
-        TIS_MAITAIKHU,
-    },
-    {
-        TIS_MAI_EK,
-        TIS_MAI_CHATTAWA,
-        TIS_MAI_CHATTAWA,
-    },
-    {
-        TIS_SARA_AA,
-        TIS_SO_RUSI,
-        TIS_SO_RUSI,
-    },
-    {
-        TIS_SO_SUA,
-        TIS_SO_SALA,
-        TIS_SO_SALA,
-    },
-    {
-        TIS_WO_WAEN,
-        TIS_SO_SO,
-        TIS_SO_SO,
-    },
-    {
-        TIS_NGO_NGU,
-        '.',
-        '.',
-    },
-    {
-        TIS_FONGMAN,
-        TIS_KHOMUT,
-        TIS_KHOMUT,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_KHO_KHON,
-        TIS_KHO_KHUAT,
-        TIS_KHO_KHUAT,
-    },
-    {
-        TIS_PHO_PHUNG,
-        '(',
-        '(',
-    },
-    {
-        TIS_PO_PLA,
-        ')',
-        ')',
-    },
-    {
-        TIS_SARA_AE,
-        TIS_CHO_CHING,
-        TIS_CHO_CHING,
-    },
-    {
-        TIS_O_ANG,
-        TIS_HO_NOKHUK,
-        TIS_HO_NOKHUK,
-    },
-    /* 0x30 */
-    {
-        TIS_SARA_I,
-        TIS_PHINTHU,
-        TIS_PHINTHU,
-    },
-    {
-        TIS_SARA_UEE,
-        TIS_THANTHAKHAT,
-        TIS_THANTHAKHAT,
-    },
-    {
-        TIS_THO_THAHAN,
-        '?',
-        '?',
-    },
-    {
-        TIS_MO_MA,
-        TIS_THO_PHUTHAO,
-        TIS_THO_PHUTHAO,
-    },
-    {
-        TIS_SARA_AI_MAIMUAN,
-        TIS_LO_CHULA,
-        TIS_LO_CHULA,
-    },
-    {
-        TIS_FO_FA,
-        TIS_LU,
-        TIS_LU,
-    },
+// Layouts are written as one string per keyboard row and shift level, with
+// the characters of the keys from left to right in UTF-8. They are expanded
+// into the tables indexed by ThaiKeycodeToChar at compile time.
+constexpr int N_ROWS = 4;
+constexpr int MAX_ROW_SIZE = 13;
+constexpr int ROW_SIZES[N_ROWS] = {13, 13, 11, 10};
+// Evdev key codes of each row.
+constexpr int ROW_KEYCODES[N_ROWS][MAX_ROW_SIZE] = {
+    // ` 1 2 3 4 5 6 7 8 9 0 - =
+    {41, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13},
+    // Q W E R T Y U I O P [ ] backslash
+    {16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 43},
+    // A S D F G H J K L ; '
+    {30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40},
+    // Z X C V B N M , . /
+    {44, 45, 46, 47, 48, 49, 50, 51, 52, 53},
 };
 
-constexpr unsigned char ketmanee_keycode_map[N_KEYCODES][N_LEVELS] = {
-    /* 0x00 */
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_LAKKHANGYAO,
-        '+',
-        '+',
-    },
-    {
-        '/',
-        TIS_THAI_DIGIT_ONE,
-        TIS_THAI_DIGIT_ONE,
-    },
-    {
-        '-',
-        TIS_THAI_DIGIT_TWO,
-        TIS_THAI_DIGIT_TWO,
-    },
-    {
-        TIS_PHO_SAMPHAO,
-        TIS_THAI_DIGIT_THREE,
-        TIS_THAI_DIGIT_THREE,
-    },
-    {
-        TIS_THO_THUNG,
-        TIS_THAI_DIGIT_FOUR,
-        TIS_THAI_DIGIT_FOUR,
-    },
-    {
-        TIS_SARA_U,
-        TIS_SARA_UU,
-        TIS_SARA_UU,
-    },
-    {
-        TIS_SARA_UE,
-        TIS_YMBOL_BAHT,
-        TIS_YMBOL_BAHT,
-    },
-    {
-        TIS_KHO_KHWAI,
-        TIS_THAI_DIGIT_FIVE,
-        TIS_THAI_DIGIT_FIVE,
-    },
-    {
-        TIS_TO_TAO,
-        TIS_THAI_DIGIT_SIX,
-        TIS_THAI_DIGIT_SIX,
-    },
-    {
-        TIS_CHO_CHAN,
-        TIS_THAI_DIGIT_SEVEN,
-        TIS_THAI_DIGIT_SEVEN,
-    },
-    {
-        TIS_KHO_KHAI,
-        TIS_THAI_DIGIT_EIGHT,
-        TIS_THAI_DIGIT_EIGHT,
-    },
-    {
-        TIS_CHO_CHANG,
-        TIS_THAI_DIGIT_NINE,
-        TIS_THAI_DIGIT_NINE,
-    },
-    {
-        0x08,
-        0x08,
-        0x08,
-    },
-    {
-        0x09,
-        0x09,
-        0x09,
-    },
-    /* 0x10 */
-    {
-        TIS_MAIYAMOK,
-        TIS_THAI_DIGIT_ZERO,
-        TIS_THAI_DIGIT_ZERO,
-    },
-    {
-        TIS_SARA_AI_MAIMALAI,
-        '"',
-        '"',
-    },
-    {
-        TIS_SARA_AM,
-        TIS_DO_CHADA,
-        TIS_DO_CHADA,
-    },
-    {
-        TIS_PHO_PHAN,
-        TIS_THO_NANGMONTHO,
-        TIS_THO_NANGMONTHO,
-    },
-    {
-        TIS_SARA_A,
-        TIS_THO_THONG,
-        TIS_THO_THONG,
-    },
-    {
-        TIS_MAI_HAN_AKAT,
-        TIS_NIKHAHIT,
-        TIS_NIKHAHIT,
-    },
-    {
-        TIS_SARA_II,
-        TIS_MAI_TRI,
-        TIS_MAI_TRI,
-    },
-    {
-        TIS_RO_RUA,
-        TIS_NO_NEN,
-        TIS_NO_NEN,
-    },
-    {
-        TIS_NO_NU,
-        TIS_PAIYANNOI,
-        TIS_PAIYANNOI,
-    },
-    {
-        TIS_YO_YAK,
-        TIS_YO_YING,
-        TIS_YO_YING,
-    },
-    {
-        TIS_BO_BAIMAI,
-        TIS_THO_THAN,
-        TIS_THO_THAN,
-    },
-    {
-        TIS_LO_LING,
-        ',',
-        ',',
-    },
-    {
-        0x0d,
-        0x0d,
-        0x0d,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_FO_FAN,
-        TIS_RU,
-        TIS_RU,
-    },
-    {
-        TIS_HO_HIP,
-        TIS_KHO_RAKHANG,
-        TIS_KHO_RAKHANG,
-    },
-    /* 0x20 */
-    {
-        TIS_KO_KAI,
-        TIS_TO_PATAK,
-        TIS_TO_PATAK,
-    },
-    {
-        TIS_DO_DEK,
-        TIS_SARA_O,
-        TIS_SARA_O,
-    },
-    {
-        TIS_SARA_E,
-        TIS_CHO_CHOE,
-        TIS_CHO_CHOE,
-    },
-    {
-        TIS_MAI_THO,
-        TIS_MAITAIKHU,
-        TIS_MAITAIKHU,
-    },
-    {
-        TIS_MAI_EK,
-        TIS_MAI_CHATTAWA,
-        TIS_MAI_CHATTAWA,
-    },
-    {
-        TIS_SARA_AA,
-        TIS_SO_RUSI,
-        TIS_SO_RUSI,
-    },
-    {
-        TIS_SO_SUA,
-        TIS_SO_SALA,
-        TIS_SO_SALA,
-    },
-    {
-        TIS_WO_WAEN,
-        TIS_SO_SO,
-        TIS_SO_SO,
-    },
-    {
-        TIS_NGO_NGU,
-        '.',
-        '.',
-    },
-    {
-        '_',
-        '%',
-        '%',
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_KHO_KHUAT,
-        TIS_KHO_KHON,
-        TIS_KHO_KHON,
-    },
-    {
-        TIS_PHO_PHUNG,
-        '(',
-        '(',
-    },
-    {
-        TIS_PO_PLA,
-        ')',
-        ')',
-    },
-    {
-        TIS_SARA_AE,
-        TIS_CHO_CHING,
-        TIS_CHO_CHING,
-    },
-    {
-        TIS_O_ANG,
-        TIS_HO_NOKHUK,
-        TIS_HO_NOKHUK,
-    },
-    /* 0x30 */
-    {
-        TIS_SARA_I,
-        TIS_PHINTHU,
-        TIS_PHINTHU,
-    },
-    {
-        TIS_SARA_UEE,
-        TIS_THANTHAKHAT,
-        TIS_THANTHAKHAT,
-    },
-    {
-        TIS_THO_THAHAN,
-        '?',
-        '?',
-    },
-    {
-        TIS_MO_MA,
-        TIS_THO_PHUTHAO,
-        TIS_THO_PHUTHAO,
-    },
-    {
-        TIS_SARA_AI_MAIMUAN,
-        TIS_LO_CHULA,
-        TIS_LO_CHULA,
-    },
-    {
-        TIS_FO_FA,
-        TIS_LU,
-        TIS_LU,
-    },
+// Keys that produce the same control character in every layout.
+constexpr int KEY_BACKSPACE = 14;
+constexpr int KEY_TAB = 15;
+constexpr int KEY_ENTER = 28;
+
+struct LayoutDescription {
+    // Levels are no modifier, Shift, and Mod5.
+    const char *rows[N_LEVELS][N_ROWS];
 };
 
-constexpr unsigned char pattachote_keycode_map[N_KEYCODES][N_LEVELS] = {
-    /* 0x00 */
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_KHO_KHUAT,
-        TIS_KHO_KHON,
-        TIS_KHO_KHON,
-    },
-    {
-        TIS_THAI_DIGIT_TWO,
-        '"',
-        '"',
-    },
-    {
-        TIS_THAI_DIGIT_THREE,
-        '/',
-        '/',
-    },
-    {
-        TIS_THAI_DIGIT_FOUR,
-        ',',
-        ',',
-    },
-    {
-        TIS_THAI_DIGIT_FIVE,
-        '?',
-        '?',
-    },
-    {
-        TIS_SARA_UU,
-        TIS_SARA_U,
-        TIS_SARA_U,
-    },
-    {
-        TIS_THAI_DIGIT_SEVEN,
-        '_',
-        '_',
-    },
-    {
-        TIS_THAI_DIGIT_EIGHT,
-        '.',
-        '.',
-    },
-    {
-        TIS_THAI_DIGIT_NINE,
-        '(',
-        '(',
-    },
-    {
-        TIS_THAI_DIGIT_ZERO,
-        ')',
-        ')',
-    },
-    {
-        TIS_THAI_DIGIT_ONE,
-        '-',
-        '-',
-    },
-    {
-        TIS_THAI_DIGIT_SIX,
-        '%',
-        '%',
-    },
-    {
-        0x08,
-        0x08,
-        0x08,
-    },
-    {
-        0x09,
-        0x09,
-        0x09,
-    },
-    /* 0x10 */
-    {
-        TIS_MAITAIKHU,
-        TIS_MAI_TRI,
-        TIS_MAI_TRI,
-    },
-    {
-        TIS_TO_TAO,
-        TIS_RU,
-        TIS_RU,
-    },
-    {
-        TIS_YO_YAK,
-        TIS_MAIYAMOK,
-        TIS_MAIYAMOK,
-    },
-    {
-        TIS_O_ANG,
-        TIS_YO_YING,
-        TIS_YO_YING,
-    },
-    {
-        TIS_RO_RUA,
-        TIS_SO_RUSI,
-        TIS_SO_RUSI,
-    },
-    {
-        TIS_MAI_EK,
-        TIS_SARA_UE,
-        TIS_SARA_UE,
-    },
-    {
-        TIS_DO_DEK,
-        TIS_FO_FA,
-        TIS_FO_FA,
-    },
-    {
-        TIS_MO_MA,
-        TIS_SO_SO,
-        TIS_SO_SO,
-    },
-    {
-        TIS_WO_WAEN,
-        TIS_THO_THUNG,
-        TIS_THO_THUNG,
-    },
-    {
-        TIS_SARA_AE,
-        TIS_THO_PHUTHAO,
-        TIS_THO_PHUTHAO,
-    },
-    {
-        TIS_SARA_AI_MAIMUAN,
-        TIS_PAIYANNOI,
-        TIS_PAIYANNOI,
-    },
-    {
-        TIS_CHO_CHOE,
-        TIS_LU,
-        TIS_LU,
-    },
-    {
-        0x0d,
-        0x0d,
-        0x0d,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_MAI_THO,
-        TIS_MAI_CHATTAWA,
-        TIS_MAI_CHATTAWA,
-    },
-    {
-        TIS_THO_THAHAN,
-        TIS_THO_THONG,
-        TIS_THO_THONG,
-    },
-    /* 0x20 */
-    {
-        TIS_NGO_NGU,
-        TIS_SARA_AM,
-        TIS_SARA_AM,
-    },
-    {
-        TIS_KO_KAI,
-        TIS_NO_NEN,
-        TIS_NO_NEN,
-    },
-    {
-        TIS_MAI_HAN_AKAT,
-        TIS_THANTHAKHAT,
-        TIS_THANTHAKHAT,
-    },
-    {
-        TIS_SARA_II,
-        TIS_SARA_UEE,
-        TIS_SARA_UEE,
-    },
-    {
-        TIS_SARA_AA,
-        TIS_PHO_PHUNG,
-        TIS_PHO_PHUNG,
-    },
-    {
-        TIS_NO_NU,
-        TIS_CHO_CHANG,
-        TIS_CHO_CHANG,
-    },
-    {
-        TIS_SARA_E,
-        TIS_SARA_O,
-        TIS_SARA_O,
-    },
-    {
-        TIS_SARA_AI_MAIMALAI,
-        TIS_KHO_RAKHANG,
-        TIS_KHO_RAKHANG,
-    },
-    {
-        TIS_KHO_KHAI,
-        TIS_THO_NANGMONTHO,
-        TIS_THO_NANGMONTHO,
-    },
-    {
-        TIS_LAKKHANGYAO,
-        TIS_YMBOL_BAHT,
-        TIS_YMBOL_BAHT,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_PHINTHU,
-        TIS_NIKHAHIT,
-        TIS_NIKHAHIT,
-    },
-    {
-        TIS_BO_BAIMAI,
-        TIS_DO_CHADA,
-        TIS_DO_CHADA,
-    },
-    {
-        TIS_PO_PLA,
-        TIS_TO_PATAK,
-        TIS_TO_PATAK,
-    },
-    {
-        TIS_LO_LING,
-        TIS_THO_THAN,
-        TIS_THO_THAN,
-    },
-    {
-        TIS_HO_HIP,
-        TIS_PHO_SAMPHAO,
-        TIS_PHO_SAMPHAO,
-    },
-    /* 0x30 */
-    {
-        TIS_SARA_I,
-        TIS_YAMAKKAN,
-        TIS_YAMAKKAN,
-    },
-    {
-        TIS_KHO_KHWAI,
-        TIS_SO_SALA,
-        TIS_SO_SALA,
-    },
-    {
-        TIS_SO_SUA,
-        TIS_HO_NOKHUK,
-        TIS_HO_NOKHUK,
-    },
-    {
-        TIS_SARA_A,
-        TIS_FO_FAN,
-        TIS_FO_FAN,
-    },
-    {
-        TIS_CHO_CHAN,
-        TIS_CHO_CHING,
-        TIS_CHO_CHING,
-    },
-    {
-        TIS_PHO_PHAN,
-        TIS_LO_CHULA,
-        TIS_LO_CHULA,
-    },
+struct DecodedChar {
+    unsigned char tis = 0;
+    // Bytes used in the UTF-8 string, 0 if it is not a TIS-620 character.
+    int length = 0;
 };
 
-constexpr unsigned char manoonchai_keycode_map[N_KEYCODES][N_LEVELS] = {
-    /* 0x00 */
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        '1',
-        '!',
-        TIS_THAI_DIGIT_ONE,
-    },
-    {'2', '@', TIS_THAI_DIGIT_TWO},
-    {'3', '#', TIS_THAI_DIGIT_THREE},
-    {'4', '$', TIS_THAI_DIGIT_FOUR},
-    {'5', '%', TIS_THAI_DIGIT_FIVE},
-    {'6', '^', TIS_THAI_DIGIT_SIX},
-    {'7', '&', TIS_THAI_DIGIT_SEVEN},
-    {'8', '*', TIS_THAI_DIGIT_EIGHT},
-    {'9', '(', TIS_THAI_DIGIT_NINE},
-    {'0', ')', TIS_THAI_DIGIT_ZERO},
-    {
-        '-',
-        '_',
-        '_',
-    },
-    {
-        '=',
-        '+',
-        '+',
-    },
-    {
-        0x08,
-        0x08,
-        0x08,
-    },
-    {
-        0x09,
-        0x09,
-        0x09,
-    },
-    /* 0x10 */
-    {
-        TIS_SARA_AI_MAIMUAN,
-        TIS_THO_PHUTHAO,
-        TIS_THO_PHUTHAO,
-    },
-    {
-        TIS_TO_TAO,
-        TIS_TO_PATAK,
-        TIS_TO_PATAK,
-    },
-    {
-        TIS_HO_HIP,
-        TIS_SO_SO,
-        TIS_SO_SO,
-    },
-    {
-        TIS_LO_LING,
-        TIS_YO_YING,
-        TIS_YO_YING,
-    },
-    {
-        TIS_SO_SUA,
-        TIS_FO_FAN,
-        TIS_FO_FAN,
-    },
-    {
-        TIS_PO_PLA,
-        TIS_CHO_CHING,
-        TIS_CHO_CHING,
-    },
-    {
-        TIS_MAI_HAN_AKAT,
-        TIS_SARA_UE,
-        TIS_PHINTHU,
-    },
-    {
-        TIS_KO_KAI,
-        TIS_THO_THONG,
-        TIS_THO_THONG,
-    },
-    {
-        TIS_SARA_I,
-        TIS_THO_THAN,
-        TIS_THO_THAN,
-    },
-    {
-        TIS_BO_BAIMAI,
-        TIS_DO_CHADA,
-        TIS_DO_CHADA,
-    },
-    {
-        TIS_MAITAIKHU,
-        TIS_KHO_RAKHANG,
-        '[',
-    },
-    {
-        TIS_LO_CHULA,
-        TIS_THO_NANGMONTHO,
-        ']',
-    },
-    {
-        0x0d,
-        0x0d,
-        0x0d,
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_NGO_NGU,
-        TIS_SO_RUSI,
-        TIS_SO_RUSI,
-    },
-    {
-        TIS_SARA_E,
-        TIS_THO_THUNG,
-        TIS_FONGMAN,
-    },
-    /* 0x20 */
-    {
-        TIS_RO_RUA,
-        TIS_SARA_AE,
-        TIS_KHOMUT,
-    },
-    {
-        TIS_NO_NU,
-        TIS_CHO_CHANG,
-        TIS_YMBOL_BAHT,
-    },
-    {
-        TIS_MO_MA,
-        TIS_PHO_PHAN,
-        TIS_PHO_PHAN,
-    },
-    {
-        TIS_O_ANG,
-        TIS_PHO_PHUNG,
-        TIS_NIKHAHIT,
-    },
-    {
-        TIS_SARA_AA,
-        TIS_SARA_AM,
-        TIS_LAKKHANGYAO,
-    },
-    {
-        TIS_MAI_EK,
-        TIS_KHO_KHAI,
-        TIS_KHO_KHUAT,
-    },
-    {
-        TIS_MAI_THO,
-        TIS_SARA_O,
-        TIS_SARA_O,
-    },
-    {
-        TIS_WO_WAEN,
-        TIS_PHO_SAMPHAO,
-        ';',
-    },
-    {
-        TIS_SARA_UE,
-        '"',
-        '\'',
-    },
-    {
-        '`',
-        '~',
-        '~',
-    },
-    {
-        0x00,
-        0x00,
-        0x00,
-    },
-    {
-        TIS_PAIYANNOI,
-        TIS_CHO_CHOE,
-        '\\',
-    },
-    {
-        TIS_SARA_U,
-        TIS_RU,
-        TIS_LU,
-    },
+// ASCII, or U+0E01..U+0E5B which is TIS-620 0xA1..0xFB.
+constexpr DecodedChar decodeChar(const char *str) {
+    const auto lead = static_cast<unsigned char>(str[0]);
+    if (lead < 0x80) {
+        return {lead, 1};
+    }
+    const auto second = static_cast<unsigned char>(str[1]);
+    if (lead != 0xE0 || (second != 0xB8 && second != 0xB9)) {
+        return {};
+    }
+    const auto third = static_cast<unsigned char>(str[2]);
+    if ((third & 0xC0) != 0x80) {
+        return {};
+    }
+    const int offset = ((second & 0x3F) << 6 | (third & 0x3F)) - 0xE00;
+    // U+0E3B..U+0E3E are unassigned.
+    if (offset < 0x01 || offset > 0x5B || (offset >= 0x3B && offset <= 0x3E)) {
+        return {};
+    }
+    return {static_cast<unsigned char>(offset + 0xA0), 3};
+}
+
+// Number of characters in row, -1 if one of them is not in TIS-620.
+constexpr int rowSize(const char *row) {
+    int size = 0;
+    while (*row) {
+        const auto chr = decodeChar(row);
+        if (!chr.length) {
+            return -1;
+        }
+        row += chr.length;
+        size++;
+    }
+    return size;
+}
+
+// Every key of every row is given, and nothing more.
+constexpr bool coversAllKeys(const LayoutDescription &layout) {
+    for (const auto &level : layout.rows) {
+        for (int row = 0; row < N_ROWS; row++) {
+            if (rowSize(level[row]) != ROW_SIZES[row]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// No character is on two keys of the same level.
+constexpr bool hasNoDuplicates(const LayoutDescription &layout) {
+    for (const auto &level : layout.rows) {
+        bool seen[256] = {};
+        for (const auto *row : level) {
+            for (; *row; row += decodeChar(row).length) {
+                const auto tis = decodeChar(row).tis;
+                if (seen[tis]) {
+                    return false;
+                }
+                seen[tis] = true;
+            }
+        }
+    }
+    return true;
+}
+
+constexpr LayoutDescription ketmanee_layout = {{
+    // No modifier
     {
-        TIS_SARA_AI_MAIMALAI,
-        TIS_FO_FA,
-        TIS_FO_FA,
+        "_ๅ/-ภถุึคตจขช",
+        "ๆไำพะัีรนยบลฃ",
+        "ฟหกดเ้่าสวง",
+        "ผปแอิืทมใฝ",
     },
+    // Shift
     {
-        TIS_THO_THAHAN,
-        TIS_MAIYAMOK,
-        TIS_ANGKHANKHU,
+        "%+๑๒๓๔ู฿๕๖๗๘๙",
+        "๐\"ฎฑธํ๊ณฯญฐ,ฅ",
+        "ฤฆฏโฌ็๋ษศซ.",
+        "()ฉฮฺ์?ฒฬฦ",
     },
+    // Mod5
     {
-        TIS_YO_YAK,
-        TIS_NO_NEN,
-        TIS_NO_NEN,
+        "%+๑๒๓๔ู฿๕๖๗๘๙",
+        "๐\"ฎฑธํ๊ณฯญฐ,ฅ",
+        "ฤฆฏโฌ็๋ษศซ.",
+        "()ฉฮฺ์?ฒฬฦ",
     },
-    /* 0x30 */
+}};
+
+constexpr LayoutDescription pattachote_layout = {{
+    // No modifier
     {
-        TIS_CHO_CHAN,
-        TIS_MAI_TRI,
-        TIS_MAI_TRI,
+        "ๅฃ๒๓๔๕ู๗๘๙๐๑๖",
+        "็ตยอร่ดมวแใฌฺ",
+        "้ทงกัีานเไข",
+        "บปลหิคสะจพ",
     },
+    // Shift
     {
-        TIS_KHO_KHWAI,
-        TIS_MAI_CHATTAWA,
-        TIS_KHO_KHON,
+        "฿ฅ\"/,?ุ_.()-%",
+        "๊ฤๆญษึฝซถฒฯฦํ",
+        "๋ธำณ์ืผชโฆฑ",
+        "ฎฏฐภ๎ศฮฟฉฬ",
     },
+    // Mod5
     {
-        TIS_SARA_II,
-        TIS_THANTHAKHAT,
-        TIS_YAMAKKAN,
+        "฿ฅ\"/,?ุ_.()-%",
+        "๊ฤๆญษึฝซถฒฯฦํ",
+        "๋ธำณ์ืผชโฆฑ",
+        "ฎฏฐภ๎ศฮฟฉฬ",
     },
+}};
+
+constexpr LayoutDescription tis_layout = {{
+    // No modifier
     {
-        TIS_DO_DEK,
-        TIS_SO_SALA,
-        ',',
+        "๏฿/-ภถุึคตจขช",
+        "ๆไำพะัีรนยบลฅ",
+        "ฟหกดเ้่าสวง",
+        "ผปแอิืทมใฝ",
     },
+    // Shift
     {
-        TIS_SARA_A,
-        TIS_HO_NOKHUK,
-        '.',
+        "๛ๅ๑๒๓๔ู๎๕๖๗๘๙",
+        "๐\"ฎฑธํ๊ณฯญฐ,ฃ",
+        "ฤฆฏโฌ็๋ษศซ.",
+        "()ฉฮฺ์?ฒฬฦ",
     },
+    // Mod5
     {
-        TIS_SARA_UU,
-        '?',
-        '/',
+        "๛ๅ๑๒๓๔ู๎๕๖๗๘๙",
+        "๐\"ฎฑธํ๊ณ๚ญฐ,ฃ",
+        "ฤฆฏโฌ็๋ษศซ.",
+        "()ฉฮฺ์?ฒฬฦ",
     },
+}};
+
+constexpr LayoutDescription manoonchai_layout = {{
+    // No modifier
+    {
+        "`1234567890-=",
+        "ใตหลสปักิบ็ฬฯ",
+        "งเรนมอา่้วึ",
+        "ุไทยจคีดะู",
+    },
+    // Shift
+    {
+        "~!@#$%^&*()_+",
+        "ฒฏซญฟฉึธฐฎฆฑฌ",
+        "ษถแชพผำขโภ\"",
+        "ฤฝๆณ๊๋์ศฮ?",
+    },
+    // Mod5
+    {
+        "~๑๒๓๔๕๖๗๘๙๐_+",
+        "ฒฏซญฟฉฺธฐฎ[]\\",
+        "ษ๏๛฿พํๅฃโ;'",
+        "ฦฝ๚ณ๊ฅ๎,./",
+    },
+}};
+constexpr LayoutDescription layouts[] = {
+    ketmanee_layout,
+    pattachote_layout,
+    tis_layout,
+    manoonchai_layout,
 };
 
-const unsigned char (*const thai_keycode_map[])[N_LEVELS] = {
-    ketmanee_keycode_map,
-    pattachote_keycode_map,
-    tis_keycode_map,
-    manoonchai_keycode_map,
+static_assert(FCITX_ARRAY_SIZE(layouts) == N_MAPS, "layouts size mismatch");
+
+static_assert(coversAllKeys(ketmanee_layout) &&
+                  hasNoDuplicates(ketmanee_layout),
+              "Invalid KETMANEE layout");
+static_assert(coversAllKeys(pattachote_layout) &&
+                  hasNoDuplicates(pattachote_layout),
+              "Invalid PATTACHOTE layout");
+static_assert(coversAllKeys(tis_layout) && hasNoDuplicates(tis_layout),
+              "Invalid TIS820_2538 layout");
+static_assert(coversAllKeys(manoonchai_layout) &&
+                  hasNoDuplicates(manoonchai_layout),
+              "Invalid Manoonchai layout");
+
+struct KeyTables {
+    unsigned char keys[N_MAPS][N_KEYCODES][N_LEVELS];
 };
 
-static_assert(FCITX_ARRAY_SIZE(thai_keycode_map) ==
-                  static_cast<int>(ThaiKBMap::Last) + 1,
-              "thai_keycode_map size mismatch");
+constexpr KeyTables makeKeyTables() {
+    KeyTables tables{};
+    for (int map = 0; map < N_MAPS; map++) {
+        for (int level = 0; level < N_LEVELS; level++) {
+            auto &keys = tables.keys[map];
+            keys[KEY_BACKSPACE][level] = '\b';
+            keys[KEY_TAB][level] = '\t';
+            keys[KEY_ENTER][level] = '\r';
+            for (int row = 0; row < N_ROWS; row++) {
+                const char *str = layouts[map].rows[level][row];
+                for (int key = 0; key < ROW_SIZES[row]; key++) {
+                    const auto chr = decodeChar(str);
+                    keys[ROW_KEYCODES[row][key]][level] = chr.tis;
+                    str += chr.length;
+                }
+            }
+        }
+    }
+    return tables;
+}
+
+// [map][keycode][level]
+constexpr KeyTables keyTables = makeKeyTables();
 
 } // namespace
 
 unsigned char ThaiKeycodeToChar(ThaiKBMap map, int keycode, int shiftLevel) {
-    if (map > ThaiKBMap::Last || shiftLevel >= N_LEVELS ||
+    if (map > ThaiKBMap::Last || shiftLevel >= N_LEVELS || keycode < 0 ||
+        keycode >= N_KEYCODES) {
+        return 0;
+    }
+
+    return keyTables.keys[static_cast<int>(map)][keycode][shiftLevel];
+}
+
+unsigned char ThaiKeycodeToChar(ThaiKeyTable table, int keycode,
+                                int shiftLevel) {
+    // X key codes below 8 have no evdev code and come out negative.
+    if (!table || shiftLevel >= N_LEVELS || keycode < 0 ||
         keycode >= N_KEYCODES) {
         return 0;
     }
 
-    return thai_keycode_map[static_cast<int>(map)][keycode][shiftLevel];
+    return table[keycode][shiftLevel];
 }
+
+template <ThaiKBMap map>
+unsigned char ThaiKeycodeToChar(int keycode, int shiftLevel) {
+    static_assert(map <= ThaiKBMap::Last, "Invalid keyboard map");
+    if (shiftLevel >= N_LEVELS || keycode < 0 || keycode >= N_KEYCODES) {
+        return 0;
+    }
+
+    return keyTables.keys[static_cast<int>(map)][keycode][shiftLevel];
+}
+
+template unsigned char ThaiKeycodeToChar<ThaiKBMap::KETMANEE>(int, int);
+template unsigned char ThaiKeycodeToChar<ThaiKBMap::PATTACHOTE>(int, int);
+template unsigned char ThaiKeycodeToChar<ThaiKBMap::TIS820_2538>(int, int);
+template unsigned char ThaiKeycodeToChar<ThaiKBMap::MANOONCHAI>(int, int);
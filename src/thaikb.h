@@ -12,9 +12,28 @@ enum class ThaiKBMap {
     PATTACHOTE,
     TIS820_2538,
     MANOONCHAI,
-    Last = MANOONCHAI
+    // Last built-in map.
+    Last = MANOONCHAI,
+    // A layout loaded from a file, see ThaiKBLayout.
+    Custom,
 };
 
+// Keyboard maps are indexed by evdev key code and shift level.
+constexpr int THAI_KB_KEYCODES = 54;
+constexpr int THAI_KB_LEVELS = 3;
+
+using ThaiKeyTable = const unsigned char (*)[THAI_KB_LEVELS];
+
+// The built-in maps are constant tables, every lookup is safe to call from
+// any thread.
 unsigned char ThaiKeycodeToChar(ThaiKBMap map, int keycode, int shiftLevel);
+// Look up a table of THAI_KB_KEYCODES entries, e.g. a loaded layout.
+unsigned char ThaiKeycodeToChar(ThaiKeyTable table, int keycode,
+                                int shiftLevel);
+
+// Same as above with the map fixed at compile time, instantiated for every
+// ThaiKBMap.
+template <ThaiKBMap map>
+unsigned char ThaiKeycodeToChar(int keycode, int shiftLevel);
 
 #endif // _FCITX5_LIBTHAI_THAIKB_H_
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "thaikblayout.h"
+#include "thaikb.h"
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <utility>
+
+namespace fcitx {
+
+namespace {
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t keycodes;
+    uint32_t levels;
+};
+
+constexpr size_t TABLE_SIZE = THAI_KB_KEYCODES * THAI_KB_LEVELS;
+
+} // namespace
+
+bool ThaiKBLayout::open(const std::string &path) {
+    close();
+    MappedFile file;
+    if (!file.open(path) || file.size() != sizeof(Header) + TABLE_SIZE) {
+        return false;
+    }
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != MAGIC || header.version != VERSION ||
+        header.keycodes != THAI_KB_KEYCODES ||
+        header.levels != THAI_KB_LEVELS) {
+        return false;
+    }
+    keys_ = reinterpret_cast<ThaiKeyTable>(file.data() + sizeof(Header));
+    file_ = std::move(file);
+    return true;
+}
+
+void ThaiKBLayout::close() {
+    file_.close();
+    keys_ = nullptr;
+}
+
+bool ThaiKBLayout::build(const unsigned char (&keys)[THAI_KB_KEYCODES]
+                                                    [THAI_KB_LEVELS],
+                         const std::string &path) {
+    const Header header{MAGIC, VERSION, THAI_KB_KEYCODES, THAI_KB_LEVELS};
+    // The engine may have the old layout mapped.
+    return MappedFile::replace(path, [&](std::ostream &out) {
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(keys), TABLE_SIZE);
+        return static_cast<bool>(out);
+    });
+}
+
+} // namespace fcitx
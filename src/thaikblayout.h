@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_THAIKBLAYOUT_H_
+#define _FCITX5_LIBTHAI_THAIKBLAYOUT_H_
+
+#include "mappedfile.h"
+#include "thaikb.h"
+#include <cstdint>
+#include <string>
+
+namespace fcitx {
+
+// User defined keyboard layout, used in place from a memory mapped file. The
+// table has the same shape as the built-in ones, so a key press indexes it
+// directly.
+//
+// File layout, integers are in host byte order:
+//   header   magic, version, key code count, level count, uint32_t each
+//   table    uint8_t[key codes][levels], TIS-620, 0 if the key has no
+//            character at that level
+class ThaiKBLayout {
+public:
+    static constexpr uint32_t MAGIC = 0x424B5446; // "FTKB"
+    static constexpr uint32_t VERSION = 1;
+
+    // Returns false if the file is missing or not a valid layout.
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const { return file_.isOpen(); }
+
+    // nullptr if no layout is open. The table is read only, so it may be
+    // looked up from several threads as long as the layout stays open.
+    ThaiKeyTable keys() const { return keys_; }
+
+    static bool build(const unsigned char (&keys)[THAI_KB_KEYCODES]
+                                                 [THAI_KB_LEVELS],
+                      const std::string &path);
+
+private:
+    MappedFile file_;
+    ThaiKeyTable keys_ = nullptr;
+};
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_THAIKBLAYOUT_H_
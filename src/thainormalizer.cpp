@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "thainormalizer.h"
+#include "thaicodec.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thai/thailib.h>
+#include <thai/thstr.h>
+#include <vector>
+
+namespace fcitx {
+
+namespace {
+
+// Every Thai character is E0 B8 xx or E0 B9 xx in UTF-8.
+constexpr uint8_t UTF8_THAI_LEAD = 0xE0;
+constexpr uint8_t UTF8_THAI_SECOND_LOW = 0xB8;
+constexpr uint8_t UTF8_THAI_SECOND_HIGH = 0xB9;
+constexpr size_t UTF8_THAI_LENGTH = 3;
+
+// U+0E01..U+0E3A and U+0E3F..U+0E5B, the part of the block in TIS-620.
+bool isThaiChar(const uint8_t *p, const uint8_t *end) {
+    if (end - p < static_cast<ptrdiff_t>(UTF8_THAI_LENGTH) ||
+        p[0] != UTF8_THAI_LEAD ||
+        (p[1] != UTF8_THAI_SECOND_LOW && p[1] != UTF8_THAI_SECOND_HIGH) ||
+        (p[2] & 0xC0) != 0x80) {
+        return false;
+    }
+    const int offset = ((p[1] & 0x3F) << 6 | (p[2] & 0x3F)) - 0xE00;
+    return (offset >= 0x01 && offset <= 0x3A) ||
+           (offset >= 0x3F && offset <= 0x5B);
+}
+
+} // namespace
+
+std::string ThaiNormalizeText(std::string_view text) {
+    std::string result;
+    result.reserve(text.size());
+    const auto *begin = reinterpret_cast<const uint8_t *>(text.data());
+    const auto *end = begin + text.size();
+    std::vector<thchar_t> run;
+    std::vector<thchar_t> normalized;
+
+    const auto *p = begin;
+    while (p < end) {
+        // The libc memchr compares a whole vector register at a time, so
+        // ASCII and other scripts are skipped at memory speed.
+        const auto *lead = static_cast<const uint8_t *>(
+            std::memchr(p, UTF8_THAI_LEAD, end - p));
+        if (!lead) {
+            break;
+        }
+        if (!isThaiChar(lead, end)) {
+            result.append(reinterpret_cast<const char *>(p), lead + 1 - p);
+            p = lead + 1;
+            continue;
+        }
+        result.append(reinterpret_cast<const char *>(p), lead - p);
+
+        const auto *runEnd = lead;
+        while (isThaiChar(runEnd, end)) {
+            runEnd += UTF8_THAI_LENGTH;
+        }
+        const size_t length = (runEnd - lead) / UTF8_THAI_LENGTH;
+        // th_normalize needs a NUL terminated string, and room for the NUL
+        // in the output.
+        run.resize(length + 1);
+        if (ThaiUtf8ToTis(
+                std::string_view(reinterpret_cast<const char *>(lead),
+                                 runEnd - lead),
+                run.data(), length) != length) {
+            // Not what the run was checked to be, leave it alone.
+            result.append(reinterpret_cast<const char *>(lead), runEnd - lead);
+            p = runEnd;
+            continue;
+        }
+        run[length] = 0;
+        normalized.resize(length + 1);
+        const size_t written =
+            th_normalize(normalized.data(), run.data(), normalized.size());
+
+        const size_t oldSize = result.size();
+        result.resize(oldSize + written * TIS_UTF8_MAX_LENGTH);
+        const size_t utf8Length =
+            ThaiTisToUtf8(normalized.data(), written, result.data() + oldSize,
+                          written * TIS_UTF8_MAX_LENGTH);
+        result.resize(oldSize + utf8Length);
+        p = runEnd;
+    }
+    result.append(reinterpret_cast<const char *>(p), end - p);
+    return result;
+}
+
+} // namespace fcitx
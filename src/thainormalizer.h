@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_THAINORMALIZER_H_
+#define _FCITX5_LIBTHAI_THAINORMALIZER_H_
+
+#include <string>
+#include <string_view>
+
+namespace fcitx {
+
+// Fix the order of vowels and tone marks in every run of Thai characters of
+// a UTF-8 text, and drop the duplicated ones, with the rules of libthai
+// th_normalize. Text copied from PDFs or legacy encodings is often stored in
+// visual order. Everything else in text is copied as is, and the cost of
+// non-Thai text is a memchr over it. Safe to call from any thread.
+std::string ThaiNormalizeText(std::string_view text);
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_THAINORMALIZER_H_
@@ -0,0 +1,316 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "thaiprediction.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fcitx {
+
+namespace {
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t poolSize;
+    uint32_t rangeCount;
+};
+
+// Ranges of up to this many words are ranked when looked up, larger ones are
+// stored.
+constexpr size_t MAX_SCAN = 256;
+
+// A stored range keeps one more word than is returned, the prefix itself
+// may be a word and is never a prediction.
+constexpr size_t RANKED_WORDS = ThaiPredictionDict::MAX_PREDICTIONS + 1;
+constexpr size_t RANGE_ENTRY_SIZE = 2 + RANKED_WORDS;
+constexpr uint32_t NO_WORD = std::numeric_limits<uint32_t>::max();
+
+bool byWeight(const ThaiPrediction &lhs, const ThaiPrediction &rhs) {
+    return lhs.weight > rhs.weight ||
+           (lhs.weight == rhs.weight && lhs.word < rhs.word);
+}
+
+} // namespace
+
+bool ThaiPredictionDict::open(const std::string &path) {
+    file_.close();
+    count_ = poolSize_ = rangeCount_ = 0;
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(Header)) {
+        return false;
+    }
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != MAGIC || header.version != VERSION) {
+        return false;
+    }
+    const size_t tableSize =
+        (size_t(header.count) * 2 +
+         size_t(header.rangeCount) * RANGE_ENTRY_SIZE) *
+        sizeof(uint32_t);
+    if (file.size() - sizeof(Header) < tableSize ||
+        file.size() - sizeof(Header) - tableSize != header.poolSize) {
+        return false;
+    }
+    const auto *tables =
+        reinterpret_cast<const uint32_t *>(file.data() + sizeof(Header));
+    pool_ = reinterpret_cast<const char *>(file.data() + sizeof(Header) +
+                                           tableSize);
+    // Every word lookup relies on the last word being terminated.
+    if (header.count && (!header.poolSize || pool_[header.poolSize - 1])) {
+        return false;
+    }
+    offsets_ = tables;
+    weights_ = tables + header.count;
+    ranges_ = weights_ + header.count;
+    rangeCount_ = header.rangeCount;
+    count_ = header.count;
+    poolSize_ = header.poolSize;
+    file_ = std::move(file);
+    return true;
+}
+
+std::string_view ThaiPredictionDict::word(size_t index) const {
+    const auto offset = offsets_[index];
+    if (offset >= poolSize_) {
+        return {};
+    }
+    return pool_ + offset;
+}
+
+size_t ThaiPredictionDict::lowerBound(std::string_view key) const {
+    size_t begin = 0;
+    size_t end = count_;
+    while (begin < end) {
+        const size_t mid = begin + (end - begin) / 2;
+        if (word(mid) < key) {
+            begin = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return begin;
+}
+
+size_t ThaiPredictionDict::prefixEnd(std::string_view prefix) const {
+    size_t begin = 0;
+    size_t end = count_;
+    while (begin < end) {
+        const size_t mid = begin + (end - begin) / 2;
+        if (word(mid).substr(0, prefix.size()) <= prefix) {
+            begin = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return begin;
+}
+
+const uint32_t *ThaiPredictionDict::rankedRange(size_t begin,
+                                                size_t end) const {
+    size_t low = 0;
+    size_t high = rangeCount_;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        const uint32_t *entry = ranges_ + mid * RANGE_ENTRY_SIZE;
+        if (entry[0] < begin || (entry[0] == begin && entry[1] < end)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == rangeCount_) {
+        return nullptr;
+    }
+    const uint32_t *entry = ranges_ + low * RANGE_ENTRY_SIZE;
+    if (entry[0] != begin || entry[1] != end) {
+        return nullptr;
+    }
+    return entry + 2;
+}
+
+bool ThaiPredictionDict::contains(std::string_view key) const {
+    const size_t index = lowerBound(key);
+    return index < count_ && word(index) == key;
+}
+
+std::vector<ThaiPrediction>
+ThaiPredictionDict::predict(std::string_view prefix, size_t limit) const {
+    std::vector<ThaiPrediction> result;
+    limit = std::min(limit, MAX_PREDICTIONS);
+    if (!count_ || prefix.empty() || !limit) {
+        return result;
+    }
+    const size_t begin = lowerBound(prefix);
+    const size_t end = prefixEnd(prefix);
+    if (end - begin > MAX_SCAN) {
+        if (const auto *ranked = rankedRange(begin, end)) {
+            for (size_t i = 0; i < RANKED_WORDS && result.size() < limit;
+                 i++) {
+                if (ranked[i] >= count_) {
+                    break;
+                }
+                const auto candidate = word(ranked[i]);
+                if (candidate.size() > prefix.size()) {
+                    result.push_back({candidate, weights_[ranked[i]]});
+                }
+            }
+            return result;
+        }
+    }
+
+    for (size_t i = begin; i < end && i - begin < MAX_SCAN; i++) {
+        const auto candidate = word(i);
+        if (candidate.size() > prefix.size()) {
+            result.push_back({candidate, weights_[i]});
+        }
+    }
+    if (result.size() > limit) {
+        std::partial_sort(result.begin(), result.begin() + limit, result.end(),
+                          byWeight);
+        result.resize(limit);
+    } else {
+        std::sort(result.begin(), result.end(), byWeight);
+    }
+    return result;
+}
+
+bool ThaiPredictionDict::build(
+    std::vector<std::pair<std::string, uint32_t>> words,
+    const std::string &path) {
+    std::sort(words.begin(), words.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.first < rhs.first ||
+               (lhs.first == rhs.first && lhs.second > rhs.second);
+    });
+    words.erase(std::unique(words.begin(), words.end(),
+                            [](const auto &lhs, const auto &rhs) {
+                                return lhs.first == rhs.first;
+                            }),
+                words.end());
+
+    words.erase(std::remove_if(words.begin(), words.end(),
+                               [](const auto &item) {
+                                   return item.first.empty() ||
+                                          item.first.find('\0') !=
+                                              std::string::npos;
+                               }),
+                words.end());
+    if (words.size() >= NO_WORD) {
+        return false;
+    }
+
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> weights;
+    std::string pool;
+    for (const auto &[word, weight] : words) {
+        if (pool.size() + word.size() + 1 >
+            std::numeric_limits<uint32_t>::max()) {
+            return false;
+        }
+        offsets.push_back(pool.size());
+        weights.push_back(weight);
+        pool.append(word);
+        pool.push_back('\0');
+    }
+
+    // Every prefix range is found from its first word: the prefixes of a word
+    // longer than what it shares with the word before it start there. They
+    // get shorter ranges as they get longer.
+    std::vector<uint32_t> ranges;
+    std::vector<uint32_t> ranked;
+    const auto heavier = [&words](uint32_t lhs, uint32_t rhs) {
+        return words[lhs].second > words[rhs].second ||
+               (words[lhs].second == words[rhs].second && lhs < rhs);
+    };
+    for (size_t begin = 0; begin < words.size(); begin++) {
+        const std::string_view word = words[begin].first;
+        size_t shared = 0;
+        if (begin) {
+            const std::string_view prev = words[begin - 1].first;
+            shared = std::mismatch(prev.begin(),
+                                   prev.begin() +
+                                       std::min(prev.size(), word.size()),
+                                   word.begin())
+                         .first -
+                     prev.begin();
+        }
+        size_t lastEnd = 0;
+        for (size_t length = shared + 1; length <= word.size(); length++) {
+            const auto prefix = word.substr(0, length);
+            const size_t end =
+                std::partition_point(
+                    words.begin() + begin, words.end(),
+                    [prefix](const auto &item) {
+                        return std::string_view(item.first)
+                                   .substr(0, prefix.size()) == prefix;
+                    }) -
+                words.begin();
+            if (end - begin <= MAX_SCAN) {
+                break;
+            }
+            if (end == lastEnd) {
+                continue;
+            }
+            lastEnd = end;
+            ranked.resize(end - begin);
+            for (size_t i = 0; i < ranked.size(); i++) {
+                ranked[i] = begin + i;
+            }
+            std::partial_sort(ranked.begin(), ranked.begin() + RANKED_WORDS,
+                              ranked.end(), heavier);
+            ranges.push_back(begin);
+            ranges.push_back(end);
+            ranges.insert(ranges.end(), ranked.begin(),
+                          ranked.begin() + RANKED_WORDS);
+        }
+    }
+    // Sort the entries by begin and end for the lookup.
+    const size_t rangeCount = ranges.size() / RANGE_ENTRY_SIZE;
+    std::vector<size_t> order(rangeCount);
+    for (size_t i = 0; i < rangeCount; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&ranges](size_t lhs, size_t rhs) {
+        const auto *a = &ranges[lhs * RANGE_ENTRY_SIZE];
+        const auto *b = &ranges[rhs * RANGE_ENTRY_SIZE];
+        return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
+    });
+    std::vector<uint32_t> sortedRanges;
+    sortedRanges.reserve(ranges.size());
+    for (auto index : order) {
+        const auto *entry = &ranges[index * RANGE_ENTRY_SIZE];
+        sortedRanges.insert(sortedRanges.end(), entry,
+                            entry + RANGE_ENTRY_SIZE);
+    }
+
+    Header header{MAGIC, VERSION, static_cast<uint32_t>(offsets.size()),
+                  static_cast<uint32_t>(pool.size()),
+                  static_cast<uint32_t>(rangeCount)};
+    // The engine may have the old dictionary mapped.
+    return MappedFile::replace(path, [&](std::ostream &out) {
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(offsets.data()),
+                  offsets.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char *>(weights.data()),
+                  weights.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char *>(sortedRanges.data()),
+                  sortedRanges.size() * sizeof(uint32_t));
+        out.write(pool.data(), pool.size());
+        return static_cast<bool>(out);
+    });
+}
+
+} // namespace fcitx
@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_THAIPREDICTION_H_
+#define _FCITX5_LIBTHAI_THAIPREDICTION_H_
+
+#include "mappedfile.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fcitx {
+
+struct ThaiPrediction {
+    // TIS-620, points into the mapped dictionary.
+    std::string_view word;
+    uint32_t weight = 0;
+};
+
+// Sorted string table of TIS-620 words, used in place from a memory mapped
+// file. Opening only validates the header, so the cost of a lookup is a
+// binary search over the pages it touches.
+//
+// The words with a prefix form a range of the table. Small ranges are ranked
+// when looked up, large ones, e.g. for the first character of a word, have
+// their best words stored at build time so that a lookup stays bounded.
+//
+// File layout, integers are in host byte order:
+//   header   magic, version, word count, pool size, range count, uint32_t
+//            each
+//   offsets  uint32_t[count], offset of each word in the pool, sorted by word
+//   weights  uint32_t[count]
+//   ranges   uint32_t[range count][2 + MAX_PREDICTIONS + 1], begin and end of
+//            each large range, then its words by descending weight, sorted
+//            by begin and end
+//   pool     NUL terminated words
+class ThaiPredictionDict {
+public:
+    static constexpr uint32_t MAGIC = 0x44505446; // "FTPD"
+    static constexpr uint32_t VERSION = 2;
+    // Most predictions returned by a single lookup.
+    static constexpr size_t MAX_PREDICTIONS = 16;
+
+    bool open(const std::string &path);
+    bool isOpen() const { return file_.isOpen(); }
+    size_t size() const { return count_; }
+
+    // Words that start with prefix and are longer than it, by descending
+    // weight, at most MAX_PREDICTIONS. The cost does not depend on the size
+    // of the dictionary.
+    std::vector<ThaiPrediction> predict(std::string_view prefix,
+                                        size_t limit) const;
+
+    bool contains(std::string_view word) const;
+
+    // Write words, TIS-620 with a weight, as a dictionary file. Duplicated
+    // words keep the highest weight.
+    static bool build(std::vector<std::pair<std::string, uint32_t>> words,
+                      const std::string &path);
+
+private:
+    std::string_view word(size_t index) const;
+    // Index of the first word not less than key.
+    size_t lowerBound(std::string_view key) const;
+    // Index of the first word after the ones that start with prefix.
+    size_t prefixEnd(std::string_view prefix) const;
+    // Stored words of a large range, nullptr if it is not stored.
+    const uint32_t *rankedRange(size_t begin, size_t end) const;
+
+    MappedFile file_;
+    const uint32_t *offsets_ = nullptr;
+    const uint32_t *weights_ = nullptr;
+    const uint32_t *ranges_ = nullptr;
+    size_t rangeCount_ = 0;
+    const char *pool_ = nullptr;
+    size_t count_ = 0;
+    size_t poolSize_ = 0;
+};
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_THAIPREDICTION_H_
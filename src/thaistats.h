@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_THAISTATS_H_
+#define _FCITX5_LIBTHAI_THAISTATS_H_
+
+#include "libthai_public.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace fcitx {
+
+inline size_t latencyBucket(std::chrono::nanoseconds latency) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency)
+                  .count();
+    size_t bucket = 0;
+    while (us > 0 && bucket + 1 < LIBTHAI_LATENCY_BUCKETS) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Always on counters of the key path. Only relaxed atomic increments are
+// done per key, so a snapshot may be taken from any thread.
+class ThaiStatsRecorder {
+public:
+    void count(LibThaiCounter counter) {
+        counters_[static_cast<size_t>(counter)].fetch_add(
+            1, std::memory_order_relaxed);
+    }
+
+    void recordLatency(std::chrono::nanoseconds latency) {
+        latency_[latencyBucket(latency)].fetch_add(1,
+                                                   std::memory_order_relaxed);
+    }
+
+    LibThaiStats snapshot() const {
+        LibThaiStats stats;
+        for (size_t i = 0; i < counters_.size(); i++) {
+            stats.counters[i] = counters_[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < latency_.size(); i++) {
+            stats.latency[i] = latency_[i].load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    void reset() {
+        for (auto &counter : counters_) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto &bucket : latency_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, LIBTHAI_COUNTERS> counters_{};
+    std::array<std::atomic<uint64_t>, LIBTHAI_LATENCY_BUCKETS> latency_{};
+};
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_THAISTATS_H_
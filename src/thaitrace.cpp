@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "thaitrace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace fcitx {
+
+namespace {
+
+const char *phaseName(ThaiTracePhase phase) {
+    switch (phase) {
+    case ThaiTracePhase::KeyEvent:
+        return "keyEvent";
+    case ThaiTracePhase::Keymap:
+        return "keymap";
+    case ThaiTracePhase::SurroundingText:
+        return "surroundingText";
+    case ThaiTracePhase::PrevCell:
+        return "th_prev_cell";
+    case ThaiTracePhase::Validate:
+        return "validate";
+    case ThaiTracePhase::DeleteSurroundingText:
+        return "deleteSurroundingText";
+    case ThaiTracePhase::Commit:
+        return "commit";
+    }
+    return "unknown";
+}
+
+struct TraceEvent {
+    uint64_t begin;
+    uint64_t end;
+    uint64_t key;
+    ThaiTracePhase phase;
+};
+
+} // namespace
+
+uint64_t ThaiTracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void ThaiTracer::setEnabled(bool enabled) {
+    // The ring is only allocated once tracing is used.
+    if (enabled && !ring_) {
+        ring_ = std::make_unique<Slot[]>(CAPACITY);
+    }
+    enabled_.store(enabled, std::memory_order_release);
+}
+
+void ThaiTracer::record(ThaiTracePhase phase, uint64_t begin, uint64_t end) {
+    const auto index = head_.fetch_add(1, std::memory_order_relaxed);
+    auto &slot = ring_[index % CAPACITY];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.begin.store(begin, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.key.store(key_.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    slot.phase.store(static_cast<uint8_t>(phase), std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+bool ThaiTracer::flush(const std::string &path) const {
+    std::vector<TraceEvent> events;
+    events.reserve(CAPACITY);
+    for (size_t i = 0; ring_ && i < CAPACITY; i++) {
+        const auto &slot = ring_[i];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == 0) {
+            continue;
+        }
+        TraceEvent event{slot.begin.load(std::memory_order_relaxed),
+                         slot.end.load(std::memory_order_relaxed),
+                         slot.key.load(std::memory_order_relaxed),
+                         static_cast<ThaiTracePhase>(
+                             slot.phase.load(std::memory_order_relaxed))};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Skip the slot if a writer raced with us.
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        events.push_back(event);
+    }
+    std::sort(events.begin(), events.end(),
+              [](const TraceEvent &lhs, const TraceEvent &rhs) {
+                  return lhs.begin < rhs.begin;
+              });
+
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    const auto pid = getpid();
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto &event : events) {
+        if (!first) {
+            out << ",";
+        }
+        first = false;
+        // Trace event timestamps are in microseconds.
+        out << "\n{\"name\":\"" << phaseName(event.phase)
+            << "\",\"cat\":\"libthai\",\"ph\":\"X\",\"ts\":"
+            << event.begin / 1000.0
+            << ",\"dur\":" << (event.end - event.begin) / 1000.0
+            << ",\"pid\":" << pid << ",\"tid\":" << pid
+            << ",\"args\":{\"key\":" << event.key << "}}";
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace fcitx
@@ -0,0 +1,95 @@
+/*
+ * SPDX-FileCopyrightText: 2020~2020 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#ifndef _FCITX5_LIBTHAI_THAITRACE_H_
+#define _FCITX5_LIBTHAI_THAITRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace fcitx {
+
+enum class ThaiTracePhase : uint8_t {
+    KeyEvent,
+    Keymap,
+    SurroundingText,
+    PrevCell,
+    Validate,
+    DeleteSurroundingText,
+    Commit,
+};
+
+// Records the phases of each key event into a fixed size in memory ring, and
+// writes them out as a Chrome trace event JSON file on demand, which can be
+// opened by chrome://tracing or Perfetto. Writers never lock, old events are
+// overwritten once the ring is full.
+class ThaiTracer {
+public:
+    static constexpr size_t CAPACITY = 8192;
+
+    bool enabled() const { return enabled_.load(std::memory_order_acquire); }
+    // Must be called from the thread that owns the tracer.
+    void setEnabled(bool enabled);
+
+    // Start a new key, following spans are tagged with its id.
+    void beginKey() { key_.fetch_add(1, std::memory_order_relaxed); }
+
+    void record(ThaiTracePhase phase, uint64_t begin, uint64_t end);
+
+    // Write all events still in the ring to path.
+    bool flush(const std::string &path) const;
+
+    static uint64_t now();
+
+private:
+    struct Slot {
+        // 0 while the slot is written, otherwise index of the event + 1.
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<uint64_t> begin{0};
+        std::atomic<uint64_t> end{0};
+        std::atomic<uint64_t> key{0};
+        std::atomic<uint8_t> phase{0};
+    };
+
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint64_t> key_{0};
+    std::atomic<uint64_t> head_{0};
+    std::unique_ptr<Slot[]> ring_;
+};
+
+// Records a span for the current scope. Only a single load is done when
+// tracing is disabled.
+class ThaiTraceSpan {
+public:
+    ThaiTraceSpan(ThaiTracer *tracer, ThaiTracePhase phase)
+        : tracer_(tracer && tracer->enabled() ? tracer : nullptr),
+          phase_(phase) {
+        if (tracer_) {
+            begin_ = ThaiTracer::now();
+        }
+    }
+
+    ~ThaiTraceSpan() {
+        if (tracer_) {
+            tracer_->record(phase_, begin_, ThaiTracer::now());
+        }
+    }
+
+    ThaiTraceSpan(const ThaiTraceSpan &) = delete;
+    ThaiTraceSpan &operator=(const ThaiTraceSpan &) = delete;
+
+private:
+    ThaiTracer *tracer_;
+    ThaiTracePhase phase_;
+    uint64_t begin_ = 0;
+};
+
+} // namespace fcitx
+
+#endif // _FCITX5_LIBTHAI_THAITRACE_H_
@@ -0,0 +1,249 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "testdir.h"
+#include "testfrontend_public.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcitx-config/rawconfig.h>
+#include <fcitx-utils/capabilityflags.h>
+#include <fcitx-utils/key.h>
+#include <fcitx-utils/keysym.h>
+#include <fcitx-utils/log.h>
+#include <fcitx-utils/macros.h>
+#include <fcitx-utils/standardpaths.h>
+#include <fcitx-utils/testing.h>
+#include <fcitx-utils/utf8.h>
+#include <fcitx/addonmanager.h>
+#include <fcitx/event.h>
+#include <fcitx/inputcontext.h>
+#include <fcitx/inputcontextmanager.h>
+#include <fcitx/inputmethodgroup.h>
+#include <fcitx/inputmethodmanager.h>
+#include <fcitx/instance.h>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace fcitx;
+
+namespace {
+
+// Benchmark for a whole key press, from the frontend to the commit. Every
+// combination of layout, strictness, correction and surrounding text support
+// is fed the same synthetic key stream.
+
+constexpr const char *keyboardMaps[] = {"KETMANEE", "PATTACHOTE",
+                                        "TIS820_2538", "Manoonchai"};
+constexpr const char *strictnessLevels[] = {"Passthrough", "Basic check",
+                                            "Strict"};
+
+// Keep the surrounding text bounded, like a client sending a paragraph.
+constexpr size_t MAX_SURROUNDING_TEXT = 256;
+
+size_t numKeys = 20000;
+
+// Keys covered by the layout tables, with evdev offset.
+std::vector<Key> makeKeyStream(size_t count) {
+    std::vector<int> codes;
+    for (int code = 10; code <= 21; code++) {
+        codes.push_back(code);
+    }
+    for (int code = 24; code <= 35; code++) {
+        codes.push_back(code);
+    }
+    for (int code = 38; code <= 49; code++) {
+        codes.push_back(code);
+    }
+    for (int code = 51; code <= 61; code++) {
+        codes.push_back(code);
+    }
+
+    std::mt19937 rng(20200101);
+    std::uniform_int_distribution<size_t> codeDist(0, codes.size() - 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<Key> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (percent(rng) < 10) {
+            keys.emplace_back(FcitxKey_space, KeyState::NoState, 65);
+            continue;
+        }
+        const auto states =
+            percent(rng) < 20 ? KeyStates(KeyState::Shift) : KeyStates();
+        // Only the key code is used to look up the layout.
+        keys.emplace_back(FcitxKey_a, states, codes[codeDist(rng)]);
+    }
+    return keys;
+}
+
+struct BenchResult {
+    double p50 = 0;
+    double p99 = 0;
+    double max = 0;
+    double keysPerSecond = 0;
+};
+
+BenchResult summarize(std::vector<double> latencies, double totalSeconds) {
+    BenchResult result;
+    if (latencies.empty()) {
+        return result;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        auto index = static_cast<size_t>(p * (latencies.size() - 1));
+        return latencies[index];
+    };
+    result.p50 = percentile(0.5);
+    result.p99 = percentile(0.99);
+    result.max = latencies.back();
+    result.keysPerSecond = latencies.size() / totalSeconds;
+    return result;
+}
+
+// Act like a client that sends surrounding text back after each commit.
+void updateSurroundingText(InputContext *ic, std::string &text,
+                           const std::string &committed) {
+    text.append(committed);
+    if (text.size() > MAX_SURROUNDING_TEXT) {
+        size_t start = text.size() - MAX_SURROUNDING_TEXT / 2;
+        // Do not cut in the middle of a character.
+        while (start < text.size() &&
+               (static_cast<uint8_t>(text[start]) & 0xC0) == 0x80) {
+            start++;
+        }
+        text.erase(0, start);
+    }
+    auto length = utf8::length(text);
+    ic->surroundingText().setText(text, length, length);
+    ic->updateSurroundingText();
+}
+
+struct BenchCase {
+    const char *keyboardMap;
+    const char *strictness;
+    bool correction;
+    bool surrounding;
+};
+
+BenchResult runCase(Instance *instance, const BenchCase &benchCase,
+                    const std::vector<Key> &keys) {
+    auto *libthai = instance->addonManager().addon("libthai", true);
+    auto *testfrontend = instance->addonManager().addon("testfrontend");
+
+    RawConfig config;
+    config.setValueByPath("KeyboardMap", benchCase.keyboardMap);
+    config.setValueByPath("Strictness", benchCase.strictness);
+    config.setValueByPath("Correction",
+                          benchCase.correction ? "True" : "False");
+    libthai->setConfig(config);
+
+    auto uuid =
+        testfrontend->call<ITestFrontend::createInputContext>("benchlibthai");
+    auto *ic = instance->inputContextManager().findByUUID(uuid);
+    FCITX_ASSERT(ic);
+    instance->setCurrentInputMethod(ic, "libthai", true);
+    if (benchCase.surrounding) {
+        ic->setCapabilityFlags(CapabilityFlag::SurroundingText);
+    }
+
+    std::string committed;
+    auto watcher = instance->watchEvent(
+        EventType::InputContextCommitString, EventWatcherPhase::Default,
+        [&committed](Event &event) {
+            auto &commitEvent = static_cast<CommitStringEvent &>(event);
+            committed.append(commitEvent.text());
+        });
+
+    std::string text;
+    std::vector<double> latencies;
+    latencies.reserve(keys.size());
+    std::chrono::duration<double> total{0};
+    for (const auto &key : keys) {
+        committed.clear();
+        auto start = std::chrono::steady_clock::now();
+        testfrontend->call<ITestFrontend::sendKeyEvent>(uuid, key, false);
+        auto end = std::chrono::steady_clock::now();
+        total += end - start;
+        latencies.push_back(
+            std::chrono::duration<double, std::micro>(end - start).count());
+        if (benchCase.surrounding && !committed.empty()) {
+            updateSurroundingText(ic, text, committed);
+        }
+    }
+    testfrontend->call<ITestFrontend::destroyInputContext>(uuid);
+    return summarize(std::move(latencies), total.count());
+}
+
+void benchmark(Instance *instance) {
+    instance->eventDispatcher().schedule([instance]() {
+        auto *libthai = instance->addonManager().addon("libthai", true);
+        FCITX_ASSERT(libthai);
+        auto defaultGroup = instance->inputMethodManager().currentGroup();
+        defaultGroup.inputMethodList().clear();
+        defaultGroup.inputMethodList().push_back(
+            InputMethodGroupItem("keyboard-us"));
+        defaultGroup.inputMethodList().push_back(
+            InputMethodGroupItem("libthai"));
+        defaultGroup.setDefaultInputMethod("");
+        instance->inputMethodManager().setGroup(std::move(defaultGroup));
+
+        const auto keys = makeKeyStream(numKeys);
+        std::printf("%-12s %-12s %-10s %-8s %10s %10s %10s %12s\n", "Layout",
+                    "Strictness", "Correction", "Surround", "p50(us)",
+                    "p99(us)", "max(us)", "keys/s");
+        for (const auto *keyboardMap : keyboardMaps) {
+            for (const auto *strictness : strictnessLevels) {
+                for (bool correction : {true, false}) {
+                    for (bool surrounding : {true, false}) {
+                        BenchCase benchCase{keyboardMap, strictness,
+                                            correction, surrounding};
+                        auto result = runCase(instance, benchCase, keys);
+                        std::printf("%-12s %-12s %-10s %-8s %10.2f %10.2f "
+                                    "%10.2f %12.0f\n",
+                                    keyboardMap, strictness,
+                                    correction ? "on" : "off",
+                                    surrounding ? "on" : "off", result.p50,
+                                    result.p99, result.max,
+                                    result.keysPerSecond);
+                    }
+                }
+            }
+        }
+
+        instance->exit();
+    });
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        numKeys = std::max(1L, std::strtol(argv[1], nullptr, 10));
+    }
+    // NOLINTBEGIN(bugprone-suspicious-missing-comma)
+    setupTestingEnvironment(
+        TESTING_BINARY_DIR, {"bin"},
+        {TESTING_BINARY_DIR "/test", TESTING_BINARY_DIR "/im",
+         TESTING_BINARY_DIR "/modules", TESTING_SOURCE_DIR "/modules",
+         StandardPaths::fcitxPath("pkgdatadir")});
+    // NOLINTEND(bugprone-suspicious-missing-comma)
+    char arg0[] = "benchlibthai";
+    char arg1[] = "--disable=all";
+    char arg2[] = "--enable=testim,testfrontend,libthai";
+    char *instanceArgv[] = {arg0, arg1, arg2};
+    // Logging would dominate the measurement.
+    Log::setLogRule("default=3,libthai=3");
+    Instance instance(FCITX_ARRAY_SIZE(instanceArgv), instanceArgv);
+    instance.addonManager().registerDefaultLoader(nullptr);
+    benchmark(&instance);
+    instance.exec();
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "iconvwrapper.h"
+#include "thaicodec.h"
+#include "thaidecision.h"
+#include "thaikb.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thai/thailib.h>
+#include <thai/thcell.h>
+#include <thai/thinp.h>
+#include <vector>
+
+// Micro benchmark for the building blocks of a key press. It does not need
+// an fcitx Instance, and prints the results as a JSON array on stdout so that
+// different builds can be compared by a script.
+
+using namespace fcitx;
+
+namespace {
+
+size_t iterations = 200000;
+
+// Prevents the compiler from dropping the benchmarked call.
+volatile size_t sink;
+
+bool first = true;
+
+template <typename Callback>
+void bench(const char *name, size_t size, size_t iterationCount,
+           Callback callback) {
+    size_t result = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterationCount; i++) {
+        result += callback(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    sink = result;
+    const double ns =
+        std::chrono::duration<double, std::nano>(end - start).count();
+    std::printf("%s{\"name\": \"%s\", \"size\": %zu, \"iterations\": %zu, "
+                "\"ns_per_op\": %.2f}",
+                first ? "" : ",\n", name, size, iterationCount,
+                ns / iterationCount);
+    first = false;
+}
+
+std::string repeat(std::string_view s, size_t count) {
+    std::string result;
+    result.reserve(s.size() * count);
+    for (size_t i = 0; i < count; i++) {
+        result.append(s);
+    }
+    return result;
+}
+
+std::vector<thchar_t> toTis(std::string_view utf8) {
+    std::vector<thchar_t> result(utf8.size());
+    auto written = ThaiUtf8ToTis(utf8, result.data(), result.size());
+    if (written == THAI_CODEC_ERROR) {
+        std::abort();
+    }
+    result.resize(written);
+    return result;
+}
+
+void benchKeymap() {
+    constexpr const char *names[] = {"KETMANEE", "PATTACHOTE", "TIS820_2538",
+                                     "Manoonchai"};
+    for (int map = 0; map <= static_cast<int>(ThaiKBMap::Last); map++) {
+        std::string name = std::string("ThaiKeycodeToChar/") + names[map];
+        bench(name.data(), 1, iterations, [map](size_t i) {
+            return ThaiKeycodeToChar(static_cast<ThaiKBMap>(map), i % 54,
+                                     i % 3);
+        });
+    }
+    // What the key handler specialized for a layout calls.
+    bench("ThaiKeycodeToChar<KETMANEE>", 1, iterations, [](size_t i) {
+        return ThaiKeycodeToChar<ThaiKBMap::KETMANEE>(i % 54, i % 3);
+    });
+}
+
+void benchConvert() {
+    IconvWrapper fromUtf8("UTF-8", "TIS-620");
+    IconvWrapper toUtf8("TIS-620", "UTF-8");
+    const std::string_view word = "สวัสดีครับ";
+    // An emoji is not representable in TIS-620.
+    const std::string_view invalidWord = "สวัสดี😀ครับ";
+
+    for (size_t count : {1, 4, 16, 64, 256}) {
+        const auto valid = repeat(word, count);
+        const auto invalid = repeat(invalidWord, count);
+        const auto tis = toTis(valid);
+        const std::string_view tisView(
+            reinterpret_cast<const char *>(tis.data()), tis.size());
+        const size_t n = std::max<size_t>(1, iterations / count / 4);
+
+        bench("IconvWrapper::tryConvert/utf8-valid", valid.size(), n,
+              [&](size_t) { return fromUtf8.tryConvert(valid).size(); });
+        bench("IconvWrapper::tryConvert/utf8-invalid", invalid.size(), n,
+              [&](size_t) { return fromUtf8.tryConvert(invalid).size(); });
+        bench("IconvWrapper::convert/utf8-invalid-substitute", invalid.size(),
+              n, [&](size_t) {
+                  return fromUtf8
+                      .convert(invalid, IconvErrorPolicy::Substitute)
+                      .output.size();
+              });
+        bench("IconvWrapper::tryConvert/tis", tis.size(), n,
+              [&](size_t) { return toUtf8.tryConvert(tisView).size(); });
+
+        std::vector<thchar_t> tisOut(valid.size());
+        std::string utf8Out(tis.size() * TIS_UTF8_MAX_LENGTH, '\0');
+        bench("ThaiUtf8ToTis", valid.size(), n, [&](size_t) {
+            return ThaiUtf8ToTis(valid, tisOut.data(), tisOut.size());
+        });
+        bench("ThaiTisToUtf8", tis.size(), n, [&](size_t) {
+            return ThaiTisToUtf8(tis.data(), tis.size(), utf8Out.data(),
+                                 utf8Out.size());
+        });
+    }
+}
+
+void benchValidation() {
+    const auto text = toTis("กินข้าวที่นี่ไหมครับ");
+    bench("th_prev_cell", text.size(), iterations, [&text](size_t i) {
+        thcell_t cell;
+        th_init_cell(&cell);
+        return th_prev_cell(text.data(), 1 + i % text.size(), &cell, true) +
+               cell.base;
+    });
+
+    // Every TIS-620 Thai character against the cells of the text.
+    std::vector<thcell_t> cells;
+    for (size_t pos = 1; pos <= text.size(); pos++) {
+        thcell_t cell;
+        th_init_cell(&cell);
+        th_prev_cell(text.data(), pos, &cell, true);
+        cells.push_back(cell);
+    }
+    const size_t numChars = 0xFB - 0xA1 + 1;
+    for (auto strictness : {ISC_PASSTHROUGH, ISC_BASICCHECK, ISC_STRICT}) {
+        std::string suffix = "/" + std::to_string(strictness);
+        bench(("th_isaccept" + suffix).data(), 1, iterations,
+              [&text, strictness, numChars](size_t i) {
+                  return th_isaccept(text[i % text.size()],
+                                     0xA1 + i % numChars, strictness);
+              });
+        bench(("th_validate_leveled" + suffix).data(), 1, iterations,
+              [&cells, strictness, numChars](size_t i) {
+                  thinpconv_t conv{};
+                  return th_validate_leveled(cells[i % cells.size()],
+                                             0xA1 + i % numChars, &conv,
+                                             strictness) +
+                         conv.offset;
+              });
+
+        ThaiDecisionTable table(strictness);
+        bench(("ThaiDecisionTable::isAccept" + suffix).data(), 1, iterations,
+              [&text, &table, numChars](size_t i) {
+                  return table.isAccept(text[i % text.size()],
+                                        0xA1 + i % numChars);
+              });
+        bench(("ThaiDecisionTable::validate" + suffix).data(), 1, iterations,
+              [&cells, &table, numChars](size_t i) {
+                  auto decision = table.validate(cells[i % cells.size()],
+                                                 0xA1 + i % numChars);
+                  return decision.accept + decision.offset;
+              });
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        iterations = std::max(1L, std::strtol(argv[1], nullptr, 10));
+    }
+    std::printf("[\n");
+    benchKeymap();
+    benchConvert();
+    benchValidation();
+    std::printf("\n]\n");
+    return 0;
+}
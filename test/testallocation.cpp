@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "testdir.h"
+#include "testfrontend_public.h"
+#include <cstddef>
+#include <cstdlib>
+#include <fcitx-config/rawconfig.h>
+#include <fcitx-utils/capabilityflags.h>
+#include <fcitx-utils/key.h>
+#include <fcitx-utils/keysym.h>
+#include <fcitx-utils/log.h>
+#include <fcitx-utils/macros.h>
+#include <fcitx-utils/standardpaths.h>
+#include <fcitx-utils/testing.h>
+#include <fcitx/addonmanager.h>
+#include <fcitx/event.h>
+#include <fcitx/inputcontext.h>
+#include <fcitx/inputcontextmanager.h>
+#include <fcitx/inputmethodengine.h>
+#include <fcitx/inputmethodmanager.h>
+#include <fcitx/instance.h>
+#include <new>
+#include <sys/types.h>
+
+namespace {
+
+thread_local bool counting = false;
+thread_local size_t allocations = 0;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+    if (counting) {
+        ++allocations;
+    }
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t /*size*/) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t /*size*/) noexcept {
+    std::free(ptr);
+}
+
+using namespace fcitx;
+
+namespace {
+
+template <typename Callback>
+size_t countAllocations(Callback callback) {
+    allocations = 0;
+    counting = true;
+    callback();
+    counting = false;
+    return allocations;
+}
+
+void testAllocation(Instance *instance) {
+    instance->eventDispatcher().schedule([instance]() {
+        auto *libthai = instance->addonManager().addon("libthai", true);
+        FCITX_ASSERT(libthai);
+        auto *engine = static_cast<InputMethodEngine *>(libthai);
+        const auto *entry = instance->inputMethodManager().entry("libthai");
+        FCITX_ASSERT(entry);
+
+        auto *testfrontend = instance->addonManager().addon("testfrontend");
+        auto uuid =
+            testfrontend->call<ITestFrontend::createInputContext>("testapp");
+        auto *ic = instance->inputContextManager().findByUUID(uuid);
+        FCITX_ASSERT(ic);
+
+        size_t commits = 0;
+        auto watcher = instance->watchEvent(
+            EventType::InputContextCommitString, EventWatcherPhase::Default,
+            [&commits](Event & /*event*/) { ++commits; });
+
+        // Allocations done by fcitx itself to deliver a single commit, these
+        // are not accounted to the engine.
+        size_t commitAllocations = 0;
+        for (int i = 0; i < 2; i++) {
+            testfrontend->call<ITestFrontend::pushCommitExpectation>("ก");
+            commitAllocations =
+                countAllocations([ic]() { ic->commitString("ก"); });
+        }
+
+        auto sendKey = [&](Key key, const char *expect) {
+            testfrontend->call<ITestFrontend::pushCommitExpectation>(expect);
+            KeyEvent event(ic, key);
+            const auto commitsBefore = commits;
+            const auto total = countAllocations([engine, entry, &event]() {
+                engine->keyEvent(*entry, event);
+            });
+            FCITX_ASSERT(event.accepted());
+            const auto engineAllocations =
+                static_cast<ssize_t>(total) -
+                static_cast<ssize_t>((commits - commitsBefore) *
+                                     commitAllocations);
+            FCITX_INFO() << "Allocations for " << key.toString() << ": "
+                         << engineAllocations;
+            FCITX_ASSERT(engineAllocations <= 0)
+                << "Key " << key.toString() << " allocated "
+                << engineAllocations;
+        };
+
+        // Warm up, the first key may initialize things lazily.
+        {
+            testfrontend->call<ITestFrontend::pushCommitExpectation>("ก");
+            KeyEvent event(ic, Key(FcitxKey_d, KeyState::NoState, 40));
+            engine->keyEvent(*entry, event);
+        }
+
+        sendKey(Key(FcitxKey_k, KeyState::NoState, 45), "า");
+        sendKey(Key(FcitxKey_f, KeyState::NoState, 41), "ด");
+        sendKey(Key(FcitxKey_a, KeyState::NoState, 38), "ฟ");
+        sendKey(Key(FcitxKey_d, KeyState::NoState, 40), "ก");
+
+        ic->setCapabilityFlags(CapabilityFlag::SurroundingText);
+        ic->surroundingText().setText("กา", 2, 2);
+        ic->updateSurroundingText();
+        sendKey(Key(FcitxKey_f, KeyState::NoState, 41), "ด");
+        sendKey(Key(FcitxKey_a, KeyState::NoState, 38), "ฟ");
+
+        RawConfig config;
+        config.setValueByPath("Correction", "False");
+        libthai->setConfig(config);
+        sendKey(Key(FcitxKey_d, KeyState::NoState, 40), "ก");
+        sendKey(Key(FcitxKey_k, KeyState::NoState, 45), "า");
+
+        instance->exit();
+    });
+}
+
+} // namespace
+
+int main() {
+    // NOLINTBEGIN(bugprone-suspicious-missing-comma)
+    setupTestingEnvironment(
+        TESTING_BINARY_DIR, {"bin"},
+        {TESTING_BINARY_DIR "/test", TESTING_BINARY_DIR "/im",
+         TESTING_BINARY_DIR "/modules", TESTING_SOURCE_DIR "/modules",
+         StandardPaths::fcitxPath("pkgdatadir")});
+    // NOLINTEND(bugprone-suspicious-missing-comma)
+    char arg0[] = "testallocation";
+    char arg1[] = "--disable=all";
+    char arg2[] = "--enable=testim,testfrontend,libthai";
+    char *argv[] = {arg0, arg1, arg2};
+    // Debug logging allocates, keep it off for libthai.
+    Log::setLogRule("default=4,libthai=4");
+    Instance instance(FCITX_ARRAY_SIZE(argv), argv);
+    instance.addonManager().registerDefaultLoader(nullptr);
+    testAllocation(&instance);
+    instance.exec();
+    return 0;
+}
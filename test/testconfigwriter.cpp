@@ -0,0 +1,95 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "configwriter.h"
+#include <fcitx-config/rawconfig.h>
+#include <fcitx-utils/log.h>
+#include <mutex>
+#include <string>
+
+using namespace fcitx;
+
+namespace {
+
+// Records what the writer thread would have written.
+class WriteLog {
+public:
+    ThaiConfigWriter::WriteCallback callback() {
+        return [this](const RawConfig &config) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            writes_++;
+            const auto *value = config.valueByPath("Value");
+            last_ = value ? value->value() : "";
+        };
+    }
+
+    int writes() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return writes_;
+    }
+
+    std::string last() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return last_;
+    }
+
+private:
+    std::mutex mutex_;
+    int writes_ = 0;
+    std::string last_;
+};
+
+RawConfig makeConfig(const std::string &value) {
+    RawConfig config;
+    config.setValueByPath("Value", value);
+    return config;
+}
+
+void testCoalesce() {
+    WriteLog log;
+    ThaiConfigWriter writer(log.callback());
+    // Nothing is written before the first save, and flush does not wait.
+    writer.flush();
+    FCITX_ASSERT(log.writes() == 0);
+
+    // Saves in quick succession are merged into one write of the last.
+    for (int i = 0; i < 5; i++) {
+        writer.save(makeConfig(std::to_string(i)));
+    }
+    // Still inside the coalescing delay.
+    FCITX_ASSERT(log.writes() == 0) << log.writes();
+    writer.flush();
+    FCITX_ASSERT(log.writes() == 1) << log.writes();
+    FCITX_ASSERT(log.last() == "4") << log.last();
+
+    // A later save is written again.
+    writer.save(makeConfig("5"));
+    writer.flush();
+    FCITX_ASSERT(log.writes() == 2) << log.writes();
+    FCITX_ASSERT(log.last() == "5") << log.last();
+}
+
+void testFlushOnDestruction() {
+    WriteLog log;
+    {
+        ThaiConfigWriter writer(log.callback());
+        writer.save(makeConfig("a"));
+        writer.save(makeConfig("b"));
+    }
+    FCITX_ASSERT(log.writes() == 1) << log.writes();
+    FCITX_ASSERT(log.last() == "b") << log.last();
+
+    // A writer that never saved does not write.
+    { ThaiConfigWriter writer(log.callback()); }
+    FCITX_ASSERT(log.writes() == 1) << log.writes();
+}
+
+} // namespace
+
+int main() {
+    testCoalesce();
+    testFlushOnDestruction();
+    return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "iconvwrapper.h"
+#include <fcitx-utils/log.h>
+#include <string>
+#include <string_view>
+
+namespace {
+
+void check(const IconvWrapper &conv, std::string_view input,
+           IconvErrorPolicy policy, std::string_view expect,
+           size_t errorOffset) {
+    const auto result = conv.convert(input, policy);
+    FCITX_ASSERT(result.output == expect)
+        << input << " -> " << std::string(result.output);
+    FCITX_ASSERT(result.errorOffset == errorOffset)
+        << input << " error at " << result.errorOffset;
+    FCITX_ASSERT(result.consumed == input.size());
+}
+
+} // namespace
+
+int main() {
+    IconvWrapper conv("UTF-8", "TIS-620");
+    FCITX_ASSERT(conv);
+
+    // ก and ข are 0xA1 and 0xA2 in TIS-620.
+    check(conv, "กข", IconvErrorPolicy::Skip, "\xA1\xA2", std::string::npos);
+
+    // Truncated sequence, the characters after it are kept.
+    check(conv, "\xE0\xB8กข", IconvErrorPolicy::Skip, "\xA1\xA2", 0);
+    check(conv, "\xE0\xB8กข", IconvErrorPolicy::Substitute, "?\xA1\xA2", 0);
+    check(conv, "ก\xE0\xB8", IconvErrorPolicy::Skip, "\xA1", 3);
+    check(conv, "ก\xE0\xB8", IconvErrorPolicy::Substitute, "\xA1?", 3);
+    check(conv, "\xF0\x9F\x98ก", IconvErrorPolicy::Substitute, "?\xA1", 0);
+
+    // Overlong encodings: no byte starts a well formed sequence, so each is
+    // replaced on its own.
+    check(conv, "\xC0\xAFก", IconvErrorPolicy::Skip, "\xA1", 0);
+    check(conv, "\xC0\xAFก", IconvErrorPolicy::Substitute, "??\xA1", 0);
+    check(conv, "\xE0\x80\xAFก", IconvErrorPolicy::Substitute, "???\xA1", 0);
+
+    // A whole character that TIS-620 can not represent is a single one.
+    check(conv, "ก😀ข", IconvErrorPolicy::Substitute, "\xA1?\xA2", 3);
+
+    // Stop leaves the rest for the caller.
+    const auto result = conv.convert("ก\xE0\xB8ข", IconvErrorPolicy::Stop);
+    FCITX_ASSERT(result.output == "\xA1");
+    FCITX_ASSERT(result.errorOffset == 3 && result.consumed == 3);
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "testdir.h"
+#include "thaicore.h"
+#include "thaikb.h"
+#include "thaikblayout.h"
+#include <fcitx-utils/key.h>
+#include <fcitx-utils/keysym.h>
+#include <fcitx-utils/log.h>
+#include <fstream>
+#include <string>
+#include <thai/tis.h>
+
+using namespace fcitx;
+
+namespace {
+
+// Evdev key code of Q.
+constexpr int KEY_Q = 16;
+
+void testLayout(const std::string &path) {
+    unsigned char keys[THAI_KB_KEYCODES][THAI_KB_LEVELS];
+    for (int code = 0; code < THAI_KB_KEYCODES; code++) {
+        for (int level = 0; level < THAI_KB_LEVELS; level++) {
+            keys[code][level] =
+                ThaiKeycodeToChar(ThaiKBMap::KETMANEE, code, level);
+        }
+    }
+    keys[KEY_Q][0] = TIS_KO_KAI;
+    FCITX_ASSERT(ThaiKBLayout::build(keys, path));
+
+    ThaiKBLayout layout;
+    FCITX_ASSERT(layout.open(path));
+    FCITX_ASSERT(ThaiKeycodeToChar(layout.keys(), KEY_Q, 0) == TIS_KO_KAI);
+    FCITX_ASSERT(ThaiKeycodeToChar(layout.keys(), KEY_Q, 1) ==
+                 ThaiKeycodeToChar(ThaiKBMap::KETMANEE, KEY_Q, 1));
+    FCITX_ASSERT(ThaiKeycodeToChar(layout.keys(), THAI_KB_KEYCODES, 0) == 0);
+    FCITX_ASSERT(ThaiKeycodeToChar(layout.keys(), -8, 0) == 0);
+    FCITX_ASSERT(ThaiKeycodeToChar(ThaiKBMap::KETMANEE, -8, 0) == 0);
+    FCITX_ASSERT(ThaiKeycodeToChar<ThaiKBMap::KETMANEE>(-8, 0) == 0);
+
+    ThaiEngineCore core;
+    ThaiCoreConfig config;
+    config.keyboardMap = ThaiKBMap::Custom;
+    config.customKeys = layout.keys();
+    core.setConfig(config);
+    const ThaiKeyDescriptor key{FcitxKey_q, KeyStates(), KEY_Q + 8};
+    FCITX_ASSERT(core.keyToChar(key) == TIS_KO_KAI);
+    auto action = core.processKey(key, {}, false);
+    FCITX_ASSERT(action.type == ThaiActionType::Commit);
+    FCITX_ASSERT(action.length == 1 && action.commit[0] == TIS_KO_KAI);
+
+    // Key code 0, as sent by automation tools, is not in any table.
+    const ThaiKeyDescriptor unknownKey{FcitxKey_q, KeyStates(), 0};
+    FCITX_ASSERT(core.keyToChar(unknownKey) == 0);
+    action = core.processKey(unknownKey, {}, false);
+    FCITX_ASSERT(action.type == ThaiActionType::Pass);
+
+    // Without a table the built-in map is used.
+    config.customKeys = nullptr;
+    core.setConfig(config);
+    action = core.processKey(key, {}, false);
+    FCITX_ASSERT(action.type == ThaiActionType::Commit);
+    FCITX_ASSERT(action.commit[0] ==
+                 ThaiKeycodeToChar(ThaiKBMap::KETMANEE, KEY_Q, 0));
+}
+
+void testRebuild(const std::string &path) {
+    unsigned char keys[THAI_KB_KEYCODES][THAI_KB_LEVELS] = {};
+    keys[KEY_Q][0] = TIS_KO_KAI;
+    FCITX_ASSERT(ThaiKBLayout::build(keys, path));
+    ThaiKBLayout layout;
+    FCITX_ASSERT(layout.open(path));
+
+    // Rebuilding replaces the file, the open layout keeps the old one.
+    keys[KEY_Q][0] = 0;
+    FCITX_ASSERT(ThaiKBLayout::build(keys, path));
+    FCITX_ASSERT(ThaiKeycodeToChar(layout.keys(), KEY_Q, 0) == TIS_KO_KAI);
+
+    ThaiKBLayout rebuilt;
+    FCITX_ASSERT(rebuilt.open(path));
+    FCITX_ASSERT(ThaiKeycodeToChar(rebuilt.keys(), KEY_Q, 0) == 0);
+}
+
+void testInvalid(const std::string &path) {
+    ThaiKBLayout layout;
+    FCITX_ASSERT(!layout.open(path + ".missing"));
+    FCITX_ASSERT(!layout.keys());
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "not a layout";
+    }
+    FCITX_ASSERT(!layout.open(path));
+    FCITX_ASSERT(!layout.keys());
+}
+
+} // namespace
+
+int main() {
+    const std::string path = TESTING_BINARY_DIR "/test/testkblayout.kb";
+    testLayout(path);
+    testRebuild(path);
+    testInvalid(path);
+    return 0;
+}
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: LGPL-2.1-or-later
  */
 #include "fcitx-utils/keysym.h"
+#include "libthai_public.h"
 #include "testdir.h"
 #include "testfrontend_public.h"
 #include <fcitx-config/rawconfig.h>
@@ -12,11 +13,17 @@
 #include <fcitx-utils/macros.h>
 #include <fcitx-utils/standardpaths.h>
 #include <fcitx-utils/testing.h>
+#include <fcitx-utils/utf8.h>
 #include <fcitx/addonmanager.h>
+#include <fcitx/inputcontext.h>
+#include <fcitx/inputcontextmanager.h>
+#include <fcitx/inputpanel.h>
 #include <fcitx/inputmethodgroup.h>
 #include <fcitx/inputmethodmanager.h>
 #include <fcitx/instance.h>
+#include <string>
 #include <utility>
+#include <vector>
 
 using namespace fcitx;
 
@@ -55,6 +62,219 @@ void testBasic(Instance *instance) {
         FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
             uuid, Key(FcitxKey_a, KeyState::NoState, 38), false));
 
+        auto stats = libthai->call<ILibThaiEngine::stats>();
+        FCITX_ASSERT(stats.counter(LibThaiCounter::Keys) == 2);
+        FCITX_ASSERT(stats.counter(LibThaiCounter::Committed) == 2);
+        auto icStats = libthai->call<ILibThaiEngine::inputContextStats>(ic);
+        FCITX_ASSERT(icStats.counter(LibThaiCounter::Committed) == 2);
+        libthai->call<ILibThaiEngine::resetStats>();
+        stats = libthai->call<ILibThaiEngine::stats>();
+        FCITX_ASSERT(stats.counter(LibThaiCounter::Keys) == 0);
+
+        testfrontend->call<ITestFrontend::destroyInputContext>(uuid);
+    });
+}
+
+void testBatch(Instance *instance) {
+    instance->eventDispatcher().schedule([instance]() {
+        auto *libthai = instance->addonManager().addon("libthai", true);
+        FCITX_ASSERT(libthai);
+        RawConfig config;
+        config.setValueByPath("KeyboardMap", "KETMANEE");
+        config.setValueByPath("CommitMode", "Immediate");
+        libthai->setConfig(config);
+
+        auto *testfrontend = instance->addonManager().addon("testfrontend");
+        auto uuid =
+            testfrontend->call<ITestFrontend::createInputContext>("testapp");
+        auto *ic = instance->inputContextManager().findByUUID(uuid);
+        FCITX_ASSERT(ic);
+        instance->setCurrentInputMethod(ic, "libthai", true);
+
+        // One commit for the whole burst, Return is left to the caller.
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("กาด");
+        const std::vector<Key> keys{
+            Key(FcitxKey_d, KeyState::NoState, 40),
+            Key(FcitxKey_k, KeyState::NoState, 45),
+            Key(FcitxKey_Shift_L, KeyState::NoState, 50),
+            Key(FcitxKey_f, KeyState::NoState, 41),
+            Key(FcitxKey_Return, KeyState::NoState, 36),
+            Key(FcitxKey_d, KeyState::NoState, 40),
+        };
+        const auto consumed =
+            libthai->call<ILibThaiEngine::processKeys>(ic, keys);
+        FCITX_ASSERT(consumed == 4) << consumed;
+
+        // Automation tools send key code 0, which is in no map and so is
+        // passed through like any other key without a character.
+        const std::vector<Key> unknownKeys{
+            Key(FcitxKey_d, KeyState::NoState, 0),
+        };
+        FCITX_ASSERT(
+            libthai->call<ILibThaiEngine::processKeys>(ic, unknownKeys) == 0);
+
+        testfrontend->call<ITestFrontend::destroyInputContext>(uuid);
+    });
+}
+
+void testPassThrough(Instance *instance) {
+    instance->eventDispatcher().schedule([instance]() {
+        auto *libthai = instance->addonManager().addon("libthai", true);
+        FCITX_ASSERT(libthai);
+        RawConfig config;
+        config.setValueByPath("KeyboardMap", "KETMANEE");
+        config.setValueByPath("CommitMode", "Immediate");
+        libthai->setConfig(config);
+
+        auto *testfrontend = instance->addonManager().addon("testfrontend");
+        auto uuid =
+            testfrontend->call<ITestFrontend::createInputContext>("testapp");
+        auto *ic = instance->inputContextManager().findByUUID(uuid);
+        FCITX_ASSERT(ic);
+        ic->setCapabilityFlags(CapabilityFlag::SurroundingText);
+        instance->setCurrentInputMethod(ic, "libthai", true);
+        // Play the client, which applies every commit to its text.
+        auto clientText = [ic](const std::string &text) {
+            const auto cursor = utf8::length(text);
+            ic->surroundingText().setText(text, cursor, cursor);
+            ic->updateSurroundingText();
+        };
+        clientText("");
+
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("ก");
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_d, KeyState::NoState, 40), false));
+        clientText("ก");
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("่");
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_j, KeyState::NoState, 44), false));
+        clientText("ก่");
+        // Space is not in the map and is inserted by the client itself.
+        FCITX_ASSERT(!testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_space, KeyState::NoState, 65), false));
+        clientText("ก่ ");
+
+        // Mai tho follows the space, not the mai ek before it, so there is
+        // nothing to correct and the space must not be deleted.
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_h, KeyState::NoState, 43), false));
+        const auto stats =
+            libthai->call<ILibThaiEngine::inputContextStats>(ic);
+        FCITX_ASSERT(stats.counter(LibThaiCounter::Corrections) == 0);
+        FCITX_ASSERT(stats.counter(LibThaiCounter::Rejected) == 1);
+
+        testfrontend->call<ITestFrontend::destroyInputContext>(uuid);
+    });
+}
+
+void testCursorMove(Instance *instance) {
+    instance->eventDispatcher().schedule([instance]() {
+        auto *libthai = instance->addonManager().addon("libthai", true);
+        FCITX_ASSERT(libthai);
+        RawConfig config;
+        config.setValueByPath("KeyboardMap", "KETMANEE");
+        config.setValueByPath("CommitMode", "Immediate");
+        libthai->setConfig(config);
+
+        auto *testfrontend = instance->addonManager().addon("testfrontend");
+        auto uuid =
+            testfrontend->call<ITestFrontend::createInputContext>("testapp");
+        auto *ic = instance->inputContextManager().findByUUID(uuid);
+        FCITX_ASSERT(ic);
+        ic->setCapabilityFlags(CapabilityFlag::SurroundingText);
+        instance->setCurrentInputMethod(ic, "libthai", true);
+        auto clientText = [ic](const std::string &text, unsigned int cursor) {
+            ic->surroundingText().setText(text, cursor, cursor);
+            ic->updateSurroundingText();
+        };
+        clientText("", 0);
+
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("ก");
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_d, KeyState::NoState, 40), false));
+        clientText("ก", 1);
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("่");
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_j, KeyState::NoState, 44), false));
+        // Sent before the client applied mai ek, so it is ignored and mai tho
+        // still replaces mai ek.
+        clientText("ก", 1);
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("้");
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_h, KeyState::NoState, 43), false));
+        auto stats = libthai->call<ILibThaiEngine::inputContextStats>(ic);
+        FCITX_ASSERT(stats.counter(LibThaiCounter::Corrections) == 1);
+
+        // A click moves the cursor after the space, and the client only
+        // sends new surrounding text. Mai ek follows the space there, so
+        // nothing is corrected and the space is kept.
+        clientText("ก้ ข", 3);
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_j, KeyState::NoState, 44), false));
+        stats = libthai->call<ILibThaiEngine::inputContextStats>(ic);
+        FCITX_ASSERT(stats.counter(LibThaiCounter::Corrections) == 1);
+        FCITX_ASSERT(stats.counter(LibThaiCounter::Rejected) == 1);
+
+        testfrontend->call<ITestFrontend::destroyInputContext>(uuid);
+    });
+}
+
+void testCellMode(Instance *instance) {
+    instance->eventDispatcher().schedule([instance]() {
+        auto *libthai = instance->addonManager().addon("libthai", true);
+        FCITX_ASSERT(libthai);
+        RawConfig config;
+        config.setValueByPath("KeyboardMap", "KETMANEE");
+        config.setValueByPath("CommitMode", "Cell");
+        libthai->setConfig(config);
+
+        auto *testfrontend = instance->addonManager().addon("testfrontend");
+        auto uuid =
+            testfrontend->call<ITestFrontend::createInputContext>("testapp");
+        auto *ic = instance->inputContextManager().findByUUID(uuid);
+        FCITX_ASSERT(ic);
+        instance->setCurrentInputMethod(ic, "libthai", true);
+
+        // The cell is only committed once the next cell starts. Any earlier
+        // commit would not match the expectation.
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("ก้า");
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_d, KeyState::NoState, 40), false));
+        // Mai ek, then replaced by mai tho inside the preedit, which does not
+        // need surrounding text.
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_j, KeyState::NoState, 44), false));
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_h, KeyState::NoState, 43), false));
+        FCITX_ASSERT(ic->inputPanel().clientPreedit().toString() == "ก้" ||
+                     ic->inputPanel().preedit().toString() == "ก้");
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_k, KeyState::NoState, 45), false));
+
+        // BackSpace edits the preedit, and Return commits it.
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_d, KeyState::NoState, 40), false));
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_BackSpace, KeyState::NoState, 22), false));
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("ด");
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_f, KeyState::NoState, 41), false));
+        testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_Return, KeyState::NoState, 36), false);
+
+        // A single word stays in the preedit until a key ends it.
+        config.setValueByPath("CommitMode", "Word");
+        config.setValueByPath("WordCommitTimeout", "0");
+        libthai->setConfig(config);
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("กา");
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_d, KeyState::NoState, 40), false));
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_k, KeyState::NoState, 45), false));
+        testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_Return, KeyState::NoState, 36), false);
+
+        testfrontend->call<ITestFrontend::destroyInputContext>(uuid);
         instance->exit();
     });
 }
@@ -77,6 +297,10 @@ int main() {
     Instance instance(FCITX_ARRAY_SIZE(argv), argv);
     instance.addonManager().registerDefaultLoader(nullptr);
     testBasic(&instance);
+    testBatch(&instance);
+    testPassThrough(&instance);
+    testCursorMove(&instance);
+    testCellMode(&instance);
     instance.exec();
     return 0;
 }
@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "testdir.h"
+#include "testfrontend_public.h"
+#include <chrono>
+#include <fcitx-utils/key.h>
+#include <fcitx-utils/keysym.h>
+#include <fcitx-utils/log.h>
+#include <fcitx-utils/macros.h>
+#include <fcitx-utils/standardpaths.h>
+#include <fcitx-utils/testing.h>
+#include <fcitx/addonmanager.h>
+#include <fcitx/inputcontextmanager.h>
+#include <fcitx/inputmethodgroup.h>
+#include <fcitx/inputmethodmanager.h>
+#include <fcitx/instance.h>
+#include <utility>
+
+using namespace fcitx;
+
+namespace {
+
+// Records how long loading the addon takes, compared with the first
+// activation and the first key, which do the deferred initialization.
+
+double elapsedMicroseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+void testLoadTime(Instance *instance) {
+    instance->eventDispatcher().schedule([instance]() {
+        auto start = std::chrono::steady_clock::now();
+        auto *libthai = instance->addonManager().addon("libthai", true);
+        const auto load = elapsedMicroseconds(start);
+        FCITX_ASSERT(libthai);
+
+        auto defaultGroup = instance->inputMethodManager().currentGroup();
+        defaultGroup.inputMethodList().clear();
+        defaultGroup.inputMethodList().push_back(
+            InputMethodGroupItem("keyboard-us"));
+        defaultGroup.inputMethodList().push_back(
+            InputMethodGroupItem("libthai"));
+        defaultGroup.setDefaultInputMethod("");
+        instance->inputMethodManager().setGroup(std::move(defaultGroup));
+
+        auto *testfrontend = instance->addonManager().addon("testfrontend");
+        auto uuid =
+            testfrontend->call<ITestFrontend::createInputContext>("testapp");
+        auto *ic = instance->inputContextManager().findByUUID(uuid);
+        FCITX_ASSERT(ic);
+
+        start = std::chrono::steady_clock::now();
+        instance->setCurrentInputMethod(ic, "libthai", true);
+        const auto activate = elapsedMicroseconds(start);
+
+        testfrontend->call<ITestFrontend::pushCommitExpectation>("ฟ");
+        start = std::chrono::steady_clock::now();
+        FCITX_ASSERT(testfrontend->call<ITestFrontend::sendKeyEvent>(
+            uuid, Key(FcitxKey_a, KeyState::NoState, 38), false));
+        const auto firstKey = elapsedMicroseconds(start);
+
+        FCITX_INFO() << "Addon load: " << load
+                     << "us, first activation: " << activate
+                     << "us, first key: " << firstKey << "us";
+
+        testfrontend->call<ITestFrontend::destroyInputContext>(uuid);
+        instance->exit();
+    });
+}
+
+} // namespace
+
+int main() {
+    // NOLINTBEGIN(bugprone-suspicious-missing-comma)
+    setupTestingEnvironment(
+        TESTING_BINARY_DIR, {"bin"},
+        {TESTING_BINARY_DIR "/test", TESTING_BINARY_DIR "/im",
+         TESTING_BINARY_DIR "/modules", TESTING_SOURCE_DIR "/modules",
+         StandardPaths::fcitxPath("pkgdatadir")});
+    // NOLINTEND(bugprone-suspicious-missing-comma)
+    char arg0[] = "testloadtime";
+    char arg1[] = "--disable=all";
+    char arg2[] = "--enable=testim,testfrontend,libthai";
+    char *argv[] = {arg0, arg1, arg2};
+    Log::setLogRule("default=3,libthai=3");
+    Instance instance(FCITX_ARRAY_SIZE(argv), argv);
+    instance.addonManager().registerDefaultLoader(nullptr);
+    testLoadTime(&instance);
+    instance.exec();
+    return 0;
+}
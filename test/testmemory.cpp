@@ -0,0 +1,157 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "testdir.h"
+#include "testfrontend_public.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fcitx-utils/key.h>
+#include <fcitx-utils/keysym.h>
+#include <fcitx-utils/log.h>
+#include <fcitx-utils/macros.h>
+#include <fcitx-utils/standardpaths.h>
+#include <fcitx-utils/testing.h>
+#include <fcitx/addonmanager.h>
+#include <fcitx/event.h>
+#include <fcitx/inputcontext.h>
+#include <fcitx/inputcontextmanager.h>
+#include <fcitx/inputmethodengine.h>
+#include <fcitx/inputmethodmanager.h>
+#include <fcitx/instance.h>
+#include <malloc.h>
+#include <new>
+#include <sys/types.h>
+#include <vector>
+
+namespace {
+
+// Bytes currently allocated with operator new.
+ssize_t liveBytes = 0;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        liveBytes += malloc_usable_size(ptr);
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+void operator delete(void *ptr) noexcept {
+    if (ptr) {
+        liveBytes -= malloc_usable_size(ptr);
+    }
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept { ::operator delete(ptr); }
+
+void operator delete(void *ptr, std::size_t /*size*/) noexcept {
+    ::operator delete(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t /*size*/) noexcept {
+    ::operator delete(ptr);
+}
+
+using namespace fcitx;
+
+namespace {
+
+constexpr size_t NUM_INPUT_CONTEXTS = 10000;
+
+// Memory used per input context while it is idle, while libthai is handling
+// keys for it, and after it is deactivated.
+void testMemory(Instance *instance) {
+    instance->eventDispatcher().schedule([instance]() {
+        auto *libthai = instance->addonManager().addon("libthai", true);
+        FCITX_ASSERT(libthai);
+        auto *engine = static_cast<InputMethodEngine *>(libthai);
+        const auto *entry = instance->inputMethodManager().entry("libthai");
+        FCITX_ASSERT(entry);
+        auto *testfrontend = instance->addonManager().addon("testfrontend");
+
+        // Initialize the engine with a first input context.
+        auto first =
+            testfrontend->call<ITestFrontend::createInputContext>("testmemory");
+        {
+            auto *ic = instance->inputContextManager().findByUUID(first);
+            KeyEvent event(ic, Key(FcitxKey_Shift_L, KeyState::NoState, 50));
+            engine->keyEvent(*entry, event);
+        }
+
+        std::vector<InputContext *> ics;
+        std::vector<ICUUID> uuids;
+        ics.reserve(NUM_INPUT_CONTEXTS);
+        uuids.reserve(NUM_INPUT_CONTEXTS);
+        const auto baseline = liveBytes;
+        for (size_t i = 0; i < NUM_INPUT_CONTEXTS; i++) {
+            auto uuid = testfrontend->call<ITestFrontend::createInputContext>(
+                "testmemory");
+            uuids.push_back(uuid);
+            ics.push_back(instance->inputContextManager().findByUUID(uuid));
+        }
+        const auto created = liveBytes;
+
+        // Shift is passed through, so nothing is committed.
+        for (auto *ic : ics) {
+            KeyEvent event(ic, Key(FcitxKey_Shift_L, KeyState::NoState, 50));
+            engine->keyEvent(*entry, event);
+        }
+        const auto active = liveBytes;
+
+        for (auto *ic : ics) {
+            InputContextEvent event(ic,
+                                    EventType::InputContextSwitchInputMethod);
+            engine->deactivate(*entry, event);
+        }
+        const auto released = liveBytes;
+
+        const auto perContext = [](ssize_t bytes) {
+            return static_cast<double>(bytes) / NUM_INPUT_CONTEXTS;
+        };
+        std::printf("Bytes per input context: %.1f created, %.1f more with "
+                    "libthai state, %.1f more after deactivate\n",
+                    perContext(created - baseline),
+                    perContext(active - created),
+                    perContext(released - created));
+        FCITX_ASSERT(active > created);
+        // Most of the per input context memory goes away with the state.
+        FCITX_ASSERT(released - created < (active - created) / 4)
+            << released - created;
+
+        for (const auto &uuid : uuids) {
+            testfrontend->call<ITestFrontend::destroyInputContext>(uuid);
+        }
+        testfrontend->call<ITestFrontend::destroyInputContext>(first);
+        instance->exit();
+    });
+}
+
+} // namespace
+
+int main() {
+    // NOLINTBEGIN(bugprone-suspicious-missing-comma)
+    setupTestingEnvironment(
+        TESTING_BINARY_DIR, {"bin"},
+        {TESTING_BINARY_DIR "/test", TESTING_BINARY_DIR "/im",
+         TESTING_BINARY_DIR "/modules", TESTING_SOURCE_DIR "/modules",
+         StandardPaths::fcitxPath("pkgdatadir")});
+    // NOLINTEND(bugprone-suspicious-missing-comma)
+    char arg0[] = "testmemory";
+    char arg1[] = "--disable=all";
+    char arg2[] = "--enable=testim,testfrontend,libthai";
+    char *argv[] = {arg0, arg1, arg2};
+    Log::setLogRule("default=3,libthai=3");
+    Instance instance(FCITX_ARRAY_SIZE(argv), argv);
+    instance.addonManager().registerDefaultLoader(nullptr);
+    testMemory(&instance);
+    instance.exec();
+    return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "thainormalizer.h"
+#include <fcitx-utils/log.h>
+#include <string>
+
+using namespace fcitx;
+
+namespace {
+
+void check(const std::string &text, const std::string &expect) {
+    const auto result = ThaiNormalizeText(text);
+    FCITX_ASSERT(result == expect) << text << " -> " << result;
+}
+
+} // namespace
+
+int main() {
+    check("", "");
+    check("hello, world", "hello, world");
+    check("สวัสดีครับ", "สวัสดีครับ");
+    // Tone mark typed before the upper vowel.
+    check("ก่ิน", "กิ่น");
+    // Duplicated tone mark.
+    check("ไก่่", "ไก่");
+    check("abc ก่ิน def", "abc กิ่น def");
+    // Other scripts and invalid UTF-8 are copied as is.
+    check("café 😀 ไก่่", "café 😀 ไก่");
+    check("\xE0\xB8", "\xE0\xB8");
+    // Not a Thai character even though the bits would decode to one.
+    check("\xE0" "8" "\x81" "abc", "\xE0" "8" "\x81" "abc");
+
+    // Large input with few Thai runs.
+    std::string text;
+    std::string expect;
+    for (int i = 0; i < 10000; i++) {
+        text.append("The quick brown fox jumps over the lazy dog. ก่ิน\n");
+        expect.append("The quick brown fox jumps over the lazy dog. กิ่น\n");
+    }
+    FCITX_ASSERT(ThaiNormalizeText(text) == expect);
+    return 0;
+}
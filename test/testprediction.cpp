@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "testdir.h"
+#include "thaicodec.h"
+#include "thaiprediction.h"
+#include <cstdint>
+#include <fcitx-utils/log.h>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace fcitx;
+
+namespace {
+
+std::string toTis(std::string_view utf8) {
+    std::string result(utf8.size(), '\0');
+    auto length = ThaiUtf8ToTis(
+        utf8, reinterpret_cast<uint8_t *>(result.data()), result.size());
+    FCITX_ASSERT(length != THAI_CODEC_ERROR);
+    result.resize(length);
+    return result;
+}
+
+void testPredict(const std::string &path) {
+    FCITX_ASSERT(ThaiPredictionDict::build(
+        {{toTis("กิน"), 50},
+         {toTis("กินข้าว"), 30},
+         {toTis("กินน้ำ"), 40},
+         {toTis("กินน้ำ"), 45},
+         {toTis("กา"), 10},
+         {toTis("ไก่"), 20}},
+        path));
+
+    ThaiPredictionDict dict;
+    FCITX_ASSERT(dict.open(path));
+    FCITX_ASSERT(dict.size() == 5) << dict.size();
+
+    auto predictions = dict.predict(toTis("กิ"), 5);
+    FCITX_ASSERT(predictions.size() == 3);
+    FCITX_ASSERT(predictions[0].word == toTis("กิน"));
+    FCITX_ASSERT(predictions[1].word == toTis("กินน้ำ"));
+    FCITX_ASSERT(predictions[1].weight == 45);
+    FCITX_ASSERT(predictions[2].word == toTis("กินข้าว"));
+
+    // The prefix itself is not a prediction.
+    predictions = dict.predict(toTis("กิน"), 1);
+    FCITX_ASSERT(predictions.size() == 1);
+    FCITX_ASSERT(predictions[0].word == toTis("กินน้ำ"));
+
+    FCITX_ASSERT(dict.contains(toTis("กินข้าว")));
+    FCITX_ASSERT(dict.contains(toTis("ไก่")));
+    FCITX_ASSERT(!dict.contains(toTis("กิ")));
+    FCITX_ASSERT(!dict.contains(toTis("ไก่ไก่")));
+
+    FCITX_ASSERT(dict.predict(toTis("ข"), 5).empty());
+    FCITX_ASSERT(dict.predict(toTis("ไก่"), 5).empty());
+}
+
+void testRebuild(const std::string &path) {
+    FCITX_ASSERT(ThaiPredictionDict::build({{toTis("กิน"), 1}}, path));
+    ThaiPredictionDict dict;
+    FCITX_ASSERT(dict.open(path));
+
+    // Rebuilding replaces the file, the open dictionary keeps the old one.
+    FCITX_ASSERT(ThaiPredictionDict::build(
+        {{toTis("กา"), 1}, {toTis("กิน"), 1}, {toTis("กินข้าว"), 1}}, path));
+    FCITX_ASSERT(dict.size() == 1);
+    FCITX_ASSERT(dict.contains(toTis("กิน")));
+    FCITX_ASSERT(!dict.contains(toTis("กา")));
+
+    ThaiPredictionDict rebuilt;
+    FCITX_ASSERT(rebuilt.open(path));
+    FCITX_ASSERT(rebuilt.size() == 3);
+}
+
+void testLargeRange(const std::string &path) {
+    // More words share the prefix than a lookup ranks, and the heaviest ones
+    // sort last.
+    std::vector<std::pair<std::string, uint32_t>> words;
+    const auto prefix = toTis("ก");
+    for (int i = 0; i < 1000; i++) {
+        words.push_back({prefix + std::to_string(1000 + i), 1});
+    }
+    words.push_back({prefix + toTis("ฮ"), 100});
+    words.push_back({prefix + toTis("ฮฮ"), 90});
+    words.push_back({toTis("ข"), 200});
+    FCITX_ASSERT(ThaiPredictionDict::build(words, path));
+
+    ThaiPredictionDict dict;
+    FCITX_ASSERT(dict.open(path));
+    auto predictions = dict.predict(prefix, 3);
+    FCITX_ASSERT(predictions.size() == 3);
+    FCITX_ASSERT(predictions[0].word == prefix + toTis("ฮ"));
+    FCITX_ASSERT(predictions[1].word == prefix + toTis("ฮฮ"));
+    FCITX_ASSERT(predictions[2].word == prefix + "1000");
+
+    predictions = dict.predict(prefix + "1", 2);
+    FCITX_ASSERT(predictions.size() == 2);
+    FCITX_ASSERT(predictions[0].word == prefix + "1000");
+    FCITX_ASSERT(predictions[1].word == prefix + "1001");
+
+    // A prefix that is also a word is not its own prediction.
+    predictions = dict.predict(prefix + toTis("ฮ"), 5);
+    FCITX_ASSERT(predictions.size() == 1);
+    FCITX_ASSERT(predictions[0].word == prefix + toTis("ฮฮ"));
+
+    FCITX_ASSERT(dict.predict(prefix, 100).size() ==
+                 ThaiPredictionDict::MAX_PREDICTIONS);
+}
+
+void testInvalid(const std::string &path) {
+    ThaiPredictionDict dict;
+    FCITX_ASSERT(!dict.open(path + ".missing"));
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "not a dictionary";
+    }
+    FCITX_ASSERT(!dict.open(path));
+    FCITX_ASSERT(dict.predict(toTis("ก"), 5).empty());
+}
+
+} // namespace
+
+int main() {
+    const std::string path = TESTING_BINARY_DIR "/test/testprediction.dict";
+    testPredict(path);
+    testRebuild(path);
+    testLargeRange(path);
+    testInvalid(path);
+    return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include "iconvwrapper.h"
+#include "thaicodec.h"
+#include "thaidecision.h"
+#include "thaikb.h"
+#include "thainormalizer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fcitx-utils/log.h>
+#include <string>
+#include <string_view>
+#include <thai/thailib.h>
+#include <thai/thcell.h>
+#include <thai/thinp.h>
+#include <thread>
+#include <vector>
+
+// Run the conversion, keymap and validation functions from many threads at
+// once and compare every result with the one computed before any thread
+// started. Build with -fsanitize=thread to also catch races that happen to
+// produce the right result.
+
+using namespace fcitx;
+
+namespace {
+
+constexpr std::string_view text = "สวัสดีครับ ภาษาไทย ไก่ กิ่น น้ำ";
+constexpr thstrict_t levels[] = {ISC_PASSTHROUGH, ISC_BASICCHECK, ISC_STRICT};
+constexpr size_t numLevels = sizeof(levels) / sizeof(levels[0]);
+constexpr size_t numMaps = static_cast<size_t>(ThaiKBMap::Last) + 1;
+
+struct Expected {
+    std::string tis;
+    std::vector<unsigned char> keys;
+    std::vector<thcell_t> cells;
+    std::vector<ThaiDecision> decisions;
+    std::string normalized;
+};
+
+// Cells of text that a character can follow, including the empty one.
+std::vector<thcell_t> makeCells(const std::string &tis) {
+    std::vector<thcell_t> cells(1);
+    th_init_cell(&cells[0]);
+    const auto *data = reinterpret_cast<const thchar_t *>(tis.data());
+    for (size_t i = 1; i <= tis.size(); i++) {
+        thcell_t cell;
+        th_init_cell(&cell);
+        th_prev_cell(data, i, &cell, true);
+        cells.push_back(cell);
+    }
+    return cells;
+}
+
+// Reference result straight from libthai.
+ThaiDecision referenceDecision(const thcell_t &cell, thchar_t c,
+                               thstrict_t strictness) {
+    thinpconv_t conv;
+    ThaiDecision decision;
+    decision.accept = th_validate_leveled(cell, c, &conv, strictness);
+    if (decision.accept) {
+        decision.offset = conv.offset;
+        while (decision.length < sizeof(decision.conv) &&
+               conv.conv[decision.length]) {
+            decision.conv[decision.length] = conv.conv[decision.length];
+            decision.length++;
+        }
+    }
+    return decision;
+}
+
+bool sameDecision(const ThaiDecision &a, const ThaiDecision &b) {
+    if (a.accept != b.accept) {
+        return false;
+    }
+    if (!a.accept) {
+        return true;
+    }
+    if (a.offset != b.offset || a.length != b.length) {
+        return false;
+    }
+    for (size_t i = 0; i < a.length; i++) {
+        if (a.conv[i] != b.conv[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Expected makeExpected() {
+    Expected expected;
+    expected.tis.resize(text.size());
+    const auto length =
+        ThaiUtf8ToTis(text, reinterpret_cast<uint8_t *>(expected.tis.data()),
+                      expected.tis.size());
+    FCITX_ASSERT(length != THAI_CODEC_ERROR);
+    expected.tis.resize(length);
+
+    for (size_t map = 0; map < numMaps; map++) {
+        for (int keycode = 0; keycode < THAI_KB_KEYCODES; keycode++) {
+            for (int level = 0; level < THAI_KB_LEVELS; level++) {
+                expected.keys.push_back(ThaiKeycodeToChar(
+                    static_cast<ThaiKBMap>(map), keycode, level));
+            }
+        }
+    }
+
+    expected.cells = makeCells(expected.tis);
+    for (thstrict_t strictness : levels) {
+        for (const auto &cell : expected.cells) {
+            for (unsigned c = 0xA1; c <= 0xFB; c++) {
+                expected.decisions.push_back(
+                    referenceDecision(cell, c, strictness));
+            }
+        }
+    }
+
+    expected.normalized = ThaiNormalizeText("ก่ิน ไก่่");
+    return expected;
+}
+
+bool checkConversion(const Expected &expected, const IconvWrapper &fromUtf8,
+                     const IconvWrapper &toUtf8) {
+    uint8_t tis[text.size()];
+    const auto length = ThaiUtf8ToTis(text, tis, sizeof(tis));
+    if (std::string_view(reinterpret_cast<const char *>(tis), length) !=
+        expected.tis) {
+        return false;
+    }
+    char utf8[sizeof(tis) * TIS_UTF8_MAX_LENGTH];
+    if (std::string_view(utf8, ThaiTisToUtf8(tis, length, utf8,
+                                             sizeof(utf8))) != text) {
+        return false;
+    }
+
+    // The same wrappers are used by every thread.
+    auto converted = fromUtf8.convert(text);
+    if (!converted.ok() || converted.output != expected.tis) {
+        return false;
+    }
+    converted = toUtf8.convert(expected.tis);
+    return converted.ok() && converted.output == text;
+}
+
+bool checkKeys(const Expected &expected) {
+    size_t index = 0;
+    for (size_t map = 0; map < numMaps; map++) {
+        for (int keycode = 0; keycode < THAI_KB_KEYCODES; keycode++) {
+            for (int level = 0; level < THAI_KB_LEVELS; level++) {
+                if (ThaiKeycodeToChar(static_cast<ThaiKBMap>(map), keycode,
+                                      level) != expected.keys[index++]) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool checkValidation(const Expected &expected, size_t seed) {
+    // Start at a different level and cell in each thread, so that threads
+    // build their tables and fill their memos in different orders.
+    const size_t perLevel = expected.cells.size() * (0xFB - 0xA1 + 1);
+    for (size_t i = 0; i < numLevels; i++) {
+        const size_t level = (seed + i) % numLevels;
+        const thstrict_t strictness = levels[level];
+        for (size_t j = 0; j < expected.cells.size(); j++) {
+            const size_t cell = (seed + j) % expected.cells.size();
+            for (unsigned c = 0xA1; c <= 0xFB; c++) {
+                const auto &expect =
+                    expected.decisions[level * perLevel +
+                                       cell * (0xFB - 0xA1 + 1) + c - 0xA1];
+                const auto decision =
+                    ThaiValidate(expected.cells[cell], c, strictness);
+                if (!sameDecision(decision, expect)) {
+                    return false;
+                }
+                if (ThaiIsAccept(0, c, strictness) !=
+                    th_isaccept(0, c, strictness)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const size_t iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+    const size_t numThreads =
+        std::max(8U, 2 * std::thread::hardware_concurrency());
+
+    IconvWrapper fromUtf8("UTF-8", "TIS-620");
+    IconvWrapper toUtf8("TIS-620", "UTF-8");
+    FCITX_ASSERT(fromUtf8 && toUtf8);
+    const auto expected = makeExpected();
+
+    std::atomic<size_t> failures{0};
+    std::vector<std::thread> threads;
+    for (size_t seed = 0; seed < numThreads; seed++) {
+        threads.emplace_back([&, seed]() {
+            for (size_t i = 0; i < iterations; i++) {
+                if (!checkConversion(expected, fromUtf8, toUtf8) ||
+                    !checkKeys(expected) ||
+                    !checkValidation(expected, seed + i) ||
+                    ThaiNormalizeText("ก่ิน ไก่่") != expected.normalized) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    FCITX_ASSERT(failures == 0) << failures << " failed iterations";
+    return 0;
+}
@@ -0,0 +1,303 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "mappedfile.h"
+#include "thaicodec.h"
+#include "thaidecision.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thai/thailib.h>
+#include <thai/thcell.h>
+#include <thai/thinp.h>
+#include <thread>
+#include <vector>
+
+// Report how each strictness level would treat the Thai text of UTF-8
+// corpora, as if it was typed one character at a time. Every Thai character
+// is checked with th_validate_leveled against the cell before it, the same
+// way the engine does, and counted as rejected, corrected (accepted with a
+// different result or by replacing previous characters) or accepted as is.
+//
+// Files are memory mapped and cut into chunks at ASCII bytes, which always
+// start a new cell, so the result does not depend on where a file is cut.
+// Chunks are checked in parallel by a work stealing pool. Conversion uses
+// the table codec, which keeps no state and is safe to use from any thread.
+
+namespace {
+
+using namespace fcitx;
+
+constexpr size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+constexpr std::array<thstrict_t, 3> strictLevels = {
+    ISC_PASSTHROUGH, ISC_BASICCHECK, ISC_STRICT};
+constexpr const char *levelNames[] = {"Passthrough", "BasicCheck", "Strict"};
+
+struct Chunk {
+    const uint8_t *data;
+    size_t size;
+};
+
+struct LevelStats {
+    uint64_t rejected = 0;
+    uint64_t corrected = 0;
+};
+
+struct Stats {
+    uint64_t bytes = 0;
+    uint64_t characters = 0;
+    std::array<LevelStats, strictLevels.size()> levels;
+
+    Stats &operator+=(const Stats &other) {
+        bytes += other.bytes;
+        characters += other.characters;
+        for (size_t i = 0; i < strictLevels.size(); i++) {
+            levels[i].rejected += other.levels[i].rejected;
+            levels[i].corrected += other.levels[i].corrected;
+        }
+        return *this;
+    }
+};
+
+void splitChunks(const MappedFile &file, std::vector<Chunk> &chunks) {
+    const uint8_t *data = file.data();
+    const size_t size = file.size();
+    size_t start = 0;
+    while (start < size) {
+        size_t end = std::min(start + CHUNK_SIZE, size);
+        while (end < size && data[end] >= 0x80) {
+            end++;
+        }
+        chunks.push_back({data + start, end - start});
+        start = end;
+    }
+}
+
+size_t utf8SequenceLength(uint8_t lead) {
+    if (lead < 0x80) {
+        return 1;
+    }
+    if (lead >= 0xC0 && lead < 0xE0) {
+        return 2;
+    }
+    if (lead >= 0xE0 && lead < 0xF0) {
+        return 3;
+    }
+    if (lead >= 0xF0 && lead < 0xF8) {
+        return 4;
+    }
+    return 1;
+}
+
+// Convert a chunk to TIS-620. Characters that TIS-620 can not represent are
+// written as a line feed so that the next character starts a new cell.
+void decodeChunk(const Chunk &chunk, std::vector<thchar_t> &tis) {
+    tis.clear();
+    tis.reserve(chunk.size);
+    size_t i = 0;
+    while (i < chunk.size) {
+        const uint8_t lead = chunk.data[i];
+        if (lead < 0x80) {
+            tis.push_back(lead);
+            i++;
+            continue;
+        }
+        const size_t length =
+            std::min(utf8SequenceLength(lead), chunk.size - i);
+        uint8_t chr;
+        const auto converted = ThaiUtf8ToTis(
+            std::string_view(reinterpret_cast<const char *>(chunk.data + i),
+                             length),
+            &chr, 1);
+        tis.push_back(converted == 1 ? chr : '\n');
+        i += length;
+    }
+}
+
+class ChunkChecker {
+public:
+    ChunkChecker() {
+        for (size_t i = 0; i < strictLevels.size(); i++) {
+            decisions_[i].setStrictness(strictLevels[i]);
+        }
+    }
+
+    void check(const Chunk &chunk) {
+        decodeChunk(chunk, tis_);
+        stats_.bytes += chunk.size;
+        for (size_t i = 0; i < tis_.size(); i++) {
+            const thchar_t c = tis_[i];
+            if (c < 0x80) {
+                continue;
+            }
+            thcell_t cell;
+            th_init_cell(&cell);
+            if (i > 0) {
+                th_prev_cell(tis_.data(), i, &cell, true);
+            }
+            stats_.characters++;
+            for (size_t level = 0; level < strictLevels.size(); level++) {
+                const auto decision = decisions_[level].validate(cell, c);
+                if (!decision.accept) {
+                    stats_.levels[level].rejected++;
+                } else if (decision.offset < 0 || decision.length != 1 ||
+                           decision.conv[0] != c) {
+                    stats_.levels[level].corrected++;
+                }
+            }
+        }
+    }
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    std::array<ThaiDecisionTable, strictLevels.size()> decisions_;
+    std::vector<thchar_t> tis_;
+    Stats stats_;
+};
+
+// Each worker starts with a contiguous range of chunks and takes them from
+// the front. Once it runs out it steals from the back of another worker, so
+// slow chunks, e.g. ones that are mostly Thai, do not leave cores idle.
+// No work is added while running, so a worker is done when every queue is
+// empty.
+class WorkStealingPool {
+public:
+    WorkStealingPool(size_t numTasks, size_t numWorkers)
+        : queues_(numWorkers) {
+        for (size_t worker = 0; worker < numWorkers; worker++) {
+            const size_t begin = numTasks * worker / numWorkers;
+            const size_t end = numTasks * (worker + 1) / numWorkers;
+            for (size_t task = begin; task < end; task++) {
+                queues_[worker].tasks.push_back(task);
+            }
+        }
+    }
+
+    template <typename Callback>
+    void run(Callback callback) {
+        std::vector<std::thread> threads;
+        for (size_t worker = 0; worker < queues_.size(); worker++) {
+            threads.emplace_back([this, worker, &callback]() {
+                size_t task;
+                while (next(worker, task)) {
+                    callback(worker, task);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool next(size_t worker, size_t &task) {
+        {
+            auto &own = queues_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues_.size(); i++) {
+            auto &victim = queues_[(worker + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> queues_;
+};
+
+double percent(uint64_t count, uint64_t total) {
+    return total ? 100.0 * count / total : 0.0;
+}
+
+void printReport(const Stats &stats, double seconds) {
+    const double mib = stats.bytes / (1024.0 * 1024.0);
+    std::cout << std::fixed << std::setprecision(2) << "Checked "
+              << stats.characters << " Thai characters in " << mib
+              << " MiB, " << seconds << " s ("
+              << (seconds > 0 ? mib / seconds : 0.0) << " MiB/s)"
+              << std::endl;
+    std::cout << std::left << std::setw(14) << "Level" << std::right
+              << std::setw(16) << "Rejected" << std::setw(10) << "%"
+              << std::setw(16) << "Corrected" << std::setw(10) << "%"
+              << std::endl;
+    for (size_t i = 0; i < strictLevels.size(); i++) {
+        const auto &level = stats.levels[i];
+        std::cout << std::left << std::setw(14) << levelNames[i]
+                  << std::right << std::setw(16) << level.rejected
+                  << std::setw(10) << percent(level.rejected, stats.characters)
+                  << std::setw(16) << level.corrected << std::setw(10)
+                  << percent(level.corrected, stats.characters) << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t numWorkers = std::max(1U, std::thread::hardware_concurrency());
+    int first = 1;
+    if (argc > 2 && std::string_view(argv[1]) == "-j") {
+        numWorkers = std::strtoul(argv[2], nullptr, 10);
+        first = 3;
+    }
+    if (first >= argc || numWorkers == 0) {
+        std::cerr << "Usage: " << argv[0] << " [-j <threads>] <corpus>..."
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<MappedFile> files(argc - first);
+    std::vector<Chunk> chunks;
+    for (int i = first; i < argc; i++) {
+        auto &file = files[i - first];
+        if (!file.open(argv[i])) {
+            std::cerr << "Failed to open " << argv[i] << std::endl;
+            return 1;
+        }
+        splitChunks(file, chunks);
+    }
+
+    numWorkers = std::min(numWorkers, chunks.size());
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<ChunkChecker> checkers(numWorkers);
+    WorkStealingPool pool(chunks.size(), numWorkers);
+    pool.run([&checkers, &chunks](size_t worker, size_t task) {
+        checkers[worker].check(chunks[task]);
+    });
+    Stats total;
+    for (const auto &checker : checkers) {
+        total += checker.stats();
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printReport(total, elapsed.count());
+    return 0;
+}
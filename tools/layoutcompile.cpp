@@ -0,0 +1,147 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "thaicodec.h"
+#include "thaikb.h"
+#include "thaikblayout.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+// Compile a keyboard layout description into the file loaded by the libthai
+// engine from libthai/layouts/<name>.kb. Lines starting with # are comments,
+// the others are one of:
+//
+//   base <map>                   Start from a built-in map, e.g. KETMANEE.
+//   key <code> <char>...         Characters of the key for each shift level.
+//
+// code is the evdev key code, e.g. 2 for the 1 key and 16 for Q. A character
+// is a single UTF-8 character representable in TIS-620, a TIS-620 byte
+// written as 0xNN, or "none". Levels that are not listed repeat the last
+// listed one.
+
+namespace {
+
+constexpr const char *builtinMaps[] = {"KETMANEE", "PATTACHOTE",
+                                       "TIS820_2538", "Manoonchai"};
+
+bool parseChar(const std::string &value, unsigned char &chr) {
+    if (value == "none") {
+        chr = 0;
+        return true;
+    }
+    if (value.size() > 2 && value[0] == '0' &&
+        (value[1] == 'x' || value[1] == 'X')) {
+        char *end = nullptr;
+        const auto parsed = std::strtoul(value.data() + 2, &end, 16);
+        if (*end || parsed > UINT8_MAX) {
+            return false;
+        }
+        chr = parsed;
+        return true;
+    }
+    uint8_t tis[2];
+    const auto length = ThaiUtf8ToTis(value, tis, sizeof(tis));
+    if (length != 1) {
+        return false;
+    }
+    chr = tis[0];
+    return true;
+}
+
+bool loadBase(const std::string &name,
+              unsigned char (&keys)[THAI_KB_KEYCODES][THAI_KB_LEVELS]) {
+    for (int map = 0; map <= static_cast<int>(ThaiKBMap::Last); map++) {
+        if (strcasecmp(name.data(), builtinMaps[map]) != 0) {
+            continue;
+        }
+        for (int code = 0; code < THAI_KB_KEYCODES; code++) {
+            for (int level = 0; level < THAI_KB_LEVELS; level++) {
+                keys[code][level] = ThaiKeycodeToChar(
+                    static_cast<ThaiKBMap>(map), code, level);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <layout description> <output>"
+                  << std::endl;
+        return 1;
+    }
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "Failed to open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    unsigned char keys[THAI_KB_KEYCODES][THAI_KB_LEVELS] = {};
+    std::string line;
+    size_t lineNumber = 0;
+    size_t numKeys = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string command;
+        if (!(fields >> command) || command[0] == '#') {
+            continue;
+        }
+        auto error = [&lineNumber](const std::string &message) {
+            std::cerr << "Line " << lineNumber << ": " << message << std::endl;
+            return 1;
+        };
+        if (command == "base") {
+            std::string name;
+            if (!(fields >> name) || !loadBase(name, keys)) {
+                return error("unknown base map " + name);
+            }
+            continue;
+        }
+        if (command != "key") {
+            return error("unknown command " + command);
+        }
+        int code = -1;
+        if (!(fields >> code) || code < 0 || code >= THAI_KB_KEYCODES) {
+            return error("invalid key code");
+        }
+        std::vector<std::string> values;
+        for (std::string value; fields >> value;) {
+            values.push_back(value);
+        }
+        if (values.empty() ||
+            values.size() > static_cast<size_t>(THAI_KB_LEVELS)) {
+            return error("expected 1 to " + std::to_string(THAI_KB_LEVELS) +
+                         " characters");
+        }
+        for (int level = 0; level < THAI_KB_LEVELS; level++) {
+            const auto &value =
+                values[std::min<size_t>(level, values.size() - 1)];
+            if (!parseChar(value, keys[code][level])) {
+                return error("not a TIS-620 character: " + value);
+            }
+        }
+        numKeys++;
+    }
+
+    if (!fcitx::ThaiKBLayout::build(keys, argv[2])) {
+        std::cerr << "Failed to write " << argv[2] << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote layout with " << numKeys << " custom keys"
+              << std::endl;
+    return 0;
+}
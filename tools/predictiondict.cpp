@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2025~2025 CSSlayer <wengxt@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+#include "thaicodec.h"
+#include "thaiprediction.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Compile a word list into the prediction dictionary used by the libthai
+// engine. Each line of the input is a UTF-8 word, optionally followed by a
+// weight, e.g. a frequency from a corpus.
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <word list> <output>"
+                  << std::endl;
+        return 1;
+    }
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "Failed to open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, uint32_t>> words;
+    std::string line;
+    size_t lineNumber = 0;
+    size_t skipped = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string word;
+        uint64_t weight = 0;
+        if (!(fields >> word)) {
+            continue;
+        }
+        fields >> weight;
+        std::string tis(word.size(), '\0');
+        auto length =
+            ThaiUtf8ToTis(word, reinterpret_cast<uint8_t *>(tis.data()),
+                          tis.size());
+        if (length == THAI_CODEC_ERROR) {
+            std::cerr << "Line " << lineNumber
+                      << ": not representable in TIS-620, skipped: " << word
+                      << std::endl;
+            skipped++;
+            continue;
+        }
+        tis.resize(length);
+        words.emplace_back(std::move(tis),
+                           static_cast<uint32_t>(std::min<uint64_t>(
+                               weight, UINT32_MAX)));
+    }
+
+    const auto total = words.size();
+    if (!fcitx::ThaiPredictionDict::build(std::move(words), argv[2])) {
+        std::cerr << "Failed to write " << argv[2] << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << total << " words, skipped " << skipped
+              << std::endl;
+    return 0;
+}